@@ -0,0 +1,554 @@
+/*
+    Headless benchmark for Pathfinding::path_between and expand_path.
+
+    Builds synthetic road networks straight into a registry, lets
+    GraphSystem derive the junction graph, then times random queries between
+    road tiles. Every path returned is walked tile by tile and its cost
+    checked against a plain Dijkstra over the tiles, as is every "no route".
+
+    Usage: pathfinding-benchmark [queries per network] [seed]
+    Exits non-zero if any query disagrees with the reference.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <components/connectivity_component.h>
+#include <components/flags.h>
+#include <components/grid_position_component.h>
+#include <components/junction_component.h>
+#include <components/path_component.h>
+#include <components/segment_component.h>
+#include <components/segment_member_component.h>
+#include <components/transform_component.h>
+#include <constants.h>
+#include <contraction_hierarchy.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <directions.h>
+#include <entt/entt.hpp>
+#include <functional>
+#include <grid.h>
+#include <limits>
+#include <new>
+#include <pathfinding.h>
+#include <pathfinding_context.h>
+#include <projection.h>
+#include <queue>
+#include <random>
+#include <string>
+#include <systems/graph_system.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::atomic<uint64_t> allocation_count { 0 };
+
+}
+
+void* operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer { std::malloc(size ? size : 1) })
+        return pointer;
+    throw std::bad_alloc {};
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace {
+
+using TileMap = Grid<entt::entity, TileMapProjection>;
+using Clock = std::chrono::steady_clock;
+
+constexpr int UNREACHED { std::numeric_limits<int>::max() };
+
+// Road tiles of a square map, row by row
+struct RoadLayout {
+    std::string name;
+    int size;
+    std::vector<bool> roads;
+
+    RoadLayout(std::string name, int size)
+        : name { name }
+        , size { size }
+        , roads(size * size, false)
+    {
+    }
+
+    void set(int x, int y) { roads[y * size + x] = true; }
+
+    bool at(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < size && y < size && roads[y * size + x];
+    }
+};
+
+// Roads along every fourth row and column, with a few blocks removed
+RoadLayout grid_layout(int size, std::mt19937& rng)
+{
+    RoadLayout layout { "grid", size };
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            if (x % 4 == 0 || y % 4 == 0)
+                layout.set(x, y);
+        }
+    }
+
+    std::uniform_int_distribution<int> block(0, size / 4 - 1);
+    for (int gap = 0; gap < size / 2; gap++) {
+        int x { block(rng) * 4 + 2 };
+        int y { block(rng) * 4 };
+        layout.roads[y * size + x] = false;
+    }
+    return layout;
+}
+
+// A random spanning tree over a lattice of junctions, so every pair of tiles
+// has exactly one route
+RoadLayout tree_layout(int size, std::mt19937& rng)
+{
+    RoadLayout layout { "tree", size };
+    const int spacing { 6 };
+    const int cells { (size - 1) / spacing + 1 };
+
+    std::vector<int> parent(cells * cells);
+    for (int index = 0; index < int(parent.size()); index++) {
+        parent[index] = index;
+    }
+
+    std::function<int(int)> find { [&](int node) {
+        return parent[node] == node ? node : parent[node] = find(parent[node]);
+    } };
+
+    std::vector<std::pair<int, int>> edges;
+    for (int y = 0; y < cells; y++) {
+        for (int x = 0; x < cells; x++) {
+            if (x + 1 < cells)
+                edges.push_back({ y * cells + x, y * cells + x + 1 });
+            if (y + 1 < cells)
+                edges.push_back({ y * cells + x, (y + 1) * cells + x });
+        }
+    }
+    std::shuffle(edges.begin(), edges.end(), rng);
+
+    for (auto [lhs, rhs] : edges) {
+        if (find(lhs) == find(rhs))
+            continue;
+        parent[find(lhs)] = find(rhs);
+
+        glm::ivec2 from { (lhs % cells) * spacing, (lhs / cells) * spacing };
+        glm::ivec2 to { (rhs % cells) * spacing, (rhs / cells) * spacing };
+        for (glm::ivec2 position = from; position != to; position += (to - from) / spacing) {
+            layout.set(position.x, position.y);
+        }
+        layout.set(to.x, to.y);
+    }
+    return layout;
+}
+
+// Concentric ring roads joined by spokes through the centre and a few more
+// at random offsets
+RoadLayout ring_layout(int size, std::mt19937& rng)
+{
+    RoadLayout layout { "ring", size };
+    const int centre { size / 2 };
+
+    for (int radius = 3; radius < centre; radius += 5) {
+        for (int offset = -radius; offset <= radius; offset++) {
+            layout.set(centre + offset, centre - radius);
+            layout.set(centre + offset, centre + radius);
+            layout.set(centre - radius, centre + offset);
+            layout.set(centre + radius, centre + offset);
+        }
+    }
+
+    for (int position = 0; position < size; position++) {
+        layout.set(centre, position);
+        layout.set(position, centre);
+    }
+
+    std::uniform_int_distribution<int> spoke(1, size - 2);
+    for (int extra = 0; extra < 4; extra++) {
+        int offset { spoke(rng) };
+        for (int position = 0; position < centre / 2; position++) {
+            layout.set(offset, position);
+            layout.set(position, offset);
+        }
+    }
+    return layout;
+}
+
+// A perfect maze carved on the odd tiles, with a few extra walls knocked
+// through so some routes have alternatives
+RoadLayout maze_layout(int size, std::mt19937& rng)
+{
+    RoadLayout layout { "maze", size };
+    const int cells { (size - 1) / 2 };
+
+    std::vector<bool> visited(cells * cells, false);
+    std::vector<glm::ivec2> stack { { 0, 0 } };
+    visited[0] = true;
+    layout.set(1, 1);
+
+    while (!stack.empty()) {
+        glm::ivec2 current { stack.back() };
+        std::vector<glm::ivec2> options;
+        for (auto direction : Direction::EachDirectionIn { Direction::TDirection::ALL_CARDINAL_DIRECTIONS }) {
+            glm::ivec2 next { current + Direction::direction_vectors.at(direction) };
+            if (next.x >= 0 && next.y >= 0 && next.x < cells && next.y < cells && !visited[next.y * cells + next.x])
+                options.push_back(next);
+        }
+
+        if (options.empty()) {
+            stack.pop_back();
+            continue;
+        }
+
+        glm::ivec2 next { options[rng() % options.size()] };
+        visited[next.y * cells + next.x] = true;
+        layout.set(current.x + next.x + 1, current.y + next.y + 1);
+        layout.set(next.x * 2 + 1, next.y * 2 + 1);
+        stack.push_back(next);
+    }
+
+    std::uniform_int_distribution<int> tile(1, size - 2);
+    for (int opening = 0; opening < size; opening++) {
+        int x { tile(rng) };
+        int y { tile(rng) };
+        if ((x + y) % 2 == 1)
+            layout.set(x, y);
+    }
+    return layout;
+}
+
+// Tiles for the whole map, with road tiles connected to their road neighbours
+void populate(entt::registry& registry, const RoadLayout& layout)
+{
+    std::vector<entt::entity> cells;
+    cells.reserve(layout.size * layout.size);
+
+    for (int y = 0; y < layout.size; y++) {
+        for (int x = 0; x < layout.size; x++) {
+            entt::entity tile { registry.create() };
+            registry.emplace<GridPositionComponent>(tile, glm::ivec2 { x, y });
+            cells.push_back(tile);
+        }
+    }
+
+    TileMap& tilemap { registry.ctx().emplace<TileMap>(cells, Constants::TILE_SIZE, glm::ivec2 { layout.size }) };
+    for (entt::entity tile : cells) {
+        glm::ivec2 position { registry.get<const GridPositionComponent>(tile).position };
+        registry.emplace<TransformComponent>(
+            tile,
+            glm::vec2 { TileMapProjection::grid_to_world(position, tilemap) },
+            0,
+            0.0
+        );
+
+        if (!layout.at(position.x, position.y))
+            continue;
+
+        uint8_t directions { 0 };
+        for (auto direction : Direction::EachDirectionIn { Direction::TDirection::ALL_CARDINAL_DIRECTIONS }) {
+            glm::ivec2 neighbour { position + Direction::direction_vectors.at(direction) };
+            if (layout.at(neighbour.x, neighbour.y))
+                directions |= Direction::to_underlying(direction);
+        }
+
+        if (directions == 0)
+            continue;
+
+        registry.emplace<ConnectivityComponent>(tile, Direction::TDirection(directions));
+        registry.emplace<ConnectivityUpdateFlag>(tile);
+    }
+}
+
+bool on_road(const entt::registry& registry, entt::entity tile)
+{
+    return registry.any_of<JunctionComponent, SegmentMemberComponent>(tile);
+}
+
+bool connected(const entt::registry& registry, entt::entity from, entt::entity to, Direction::TDirection direction)
+{
+    const ConnectivityComponent* from_connectivity { registry.try_get<const ConnectivityComponent>(from) };
+    const ConnectivityComponent* to_connectivity { registry.try_get<const ConnectivityComponent>(to) };
+
+    return from_connectivity && to_connectivity
+        && Direction::any(from_connectivity->directions & direction)
+        && Direction::any(to_connectivity->directions & Direction::reverse(direction));
+}
+
+/*
+    Reference costs from one road tile to every other, by Dijkstra over the
+    tiles themselves: a step costs one, plus the crossing cost when it leaves
+    a junction other than the starting tile.
+*/
+class Reference {
+    const entt::registry& registry;
+    const TileMap& tilemap;
+    std::vector<int> distance;
+
+public:
+    Reference(const entt::registry& registry)
+        : registry { registry }
+        , tilemap { registry.ctx().get<const TileMap>() }
+        , distance(tilemap.cells.size(), UNREACHED)
+    {
+    }
+
+    void search_from(entt::entity from_tile)
+    {
+        using Entry = std::pair<int, int>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> frontier;
+
+        std::fill(distance.begin(), distance.end(), UNREACHED);
+        glm::ivec2 start { registry.get<const GridPositionComponent>(from_tile).position };
+        int start_index { start.y * tilemap.grid_dimensions.x + start.x };
+        distance[start_index] = 0;
+        frontier.push({ 0, start_index });
+
+        while (!frontier.empty()) {
+            auto [cost, index] { frontier.top() };
+            frontier.pop();
+            if (cost > distance[index])
+                continue;
+
+            entt::entity tile { tilemap.cells[index] };
+            int step_cost { 1 };
+            if (index != start_index && registry.all_of<JunctionComponent>(tile))
+                step_cost += Constants::JUNCTION_CROSSING_COST;
+
+            glm::ivec2 position { index % tilemap.grid_dimensions.x, index / tilemap.grid_dimensions.x };
+            for (auto direction : Direction::EachDirectionIn { Direction::TDirection::ALL_CARDINAL_DIRECTIONS }) {
+                glm::ivec2 next { position + Direction::direction_vectors.at(direction) };
+                if (!tilemap.position_is_valid(next) || !connected(registry, tile, tilemap[next], direction))
+                    continue;
+
+                int next_index { next.y * tilemap.grid_dimensions.x + next.x };
+                if (cost + step_cost < distance[next_index]) {
+                    distance[next_index] = cost + step_cost;
+                    frontier.push({ cost + step_cost, next_index });
+                }
+            }
+        }
+    }
+
+    // The cheapest walk to a road tile on or beside the target; NO_ROUTE if none
+    int cost_to(entt::entity to_tile) const
+    {
+        glm::ivec2 target { registry.get<const GridPositionComponent>(to_tile).position };
+        int best { UNREACHED };
+
+        auto consider { [&](glm::ivec2 position) {
+            if (!tilemap.position_is_valid(position) || !on_road(registry, tilemap[position]))
+                return;
+            best = std::min(best, distance[position.y * tilemap.grid_dimensions.x + position.x]);
+        } };
+
+        consider(target);
+        for (auto direction : Direction::EachDirectionIn { Direction::TDirection::ALL_CARDINAL_DIRECTIONS }) {
+            consider(target + Direction::direction_vectors.at(direction));
+        }
+
+        return best == UNREACHED ? Pathfinding::NO_ROUTE : best;
+    }
+};
+
+// Walk the path tile by tile, costing it as the reference does; NO_ROUTE if
+// any step is not along a connected road
+int walk_cost(const entt::registry& registry, const std::vector<entt::entity>& path)
+{
+    const TileMap& tilemap { registry.ctx().get<const TileMap>() };
+    int cost { 0 };
+
+    for (size_t index = 0; index + 1 < path.size(); index++) {
+        glm::ivec2 from { registry.get<const GridPositionComponent>(path[index]).position };
+        glm::ivec2 to { registry.get<const GridPositionComponent>(path[index + 1]).position };
+        glm::ivec2 delta { to - from };
+
+        if ((delta.x != 0) == (delta.y != 0))
+            return Pathfinding::NO_ROUTE;
+
+        glm::ivec2 step { (delta.x > 0) - (delta.x < 0), (delta.y > 0) - (delta.y < 0) };
+        Direction::TDirection direction { Direction::vector_directions.at(step) };
+
+        for (glm::ivec2 position = from; position != to; position += step) {
+            if (!connected(registry, tilemap[position], tilemap[position + step], direction))
+                return Pathfinding::NO_ROUTE;
+
+            cost++;
+            if ((index != 0 || position != from) && registry.all_of<JunctionComponent>(tilemap[position]))
+                cost += Constants::JUNCTION_CROSSING_COST;
+        }
+    }
+
+    return cost;
+}
+
+double percentile(std::vector<double>& samples, double fraction)
+{
+    if (samples.empty())
+        return 0.0;
+
+    size_t rank { std::min(samples.size() - 1, size_t(fraction * samples.size())) };
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+struct Results {
+    size_t queries { 0 };
+    size_t routed { 0 };
+    size_t mismatches { 0 };
+    uint64_t expanded { 0 };
+    uint64_t search_allocations { 0 };
+    uint64_t expand_allocations { 0 };
+    std::vector<double> search_micros;
+    std::vector<double> expand_micros;
+};
+
+double micros_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+Results run(const RoadLayout& layout, int query_count, std::mt19937& rng)
+{
+    entt::registry registry;
+    registry.on_construct<SegmentComponent>().connect<&GraphSystem::create>();
+
+    populate(registry, layout);
+    GraphSystem::update(registry);
+
+    const TileMap& tilemap { registry.ctx().get<const TileMap>() };
+    std::vector<entt::entity> roads;
+    for (entt::entity tile : tilemap.cells) {
+        if (on_road(registry, tile))
+            roads.push_back(tile);
+    }
+
+    Results results {};
+    if (roads.size() < 2)
+        return results;
+
+    PathfindingContext& context { registry.ctx().emplace<PathfindingContext>() };
+    Reference reference { registry };
+    std::vector<entt::entity> path;
+    std::vector<PathSegment> expanded_path;
+
+    // Warm up the context's buffers so the timings show steady state
+    Pathfinding::path_between(registry, roads.front(), roads.back(), path);
+    path.reserve(tilemap.cells.size());
+    expanded_path.reserve(tilemap.cells.size());
+    context.expanded = 0;
+
+    std::uniform_int_distribution<size_t> pick_road(0, roads.size() - 1);
+    std::uniform_int_distribution<size_t> pick_tile(0, tilemap.cells.size() - 1);
+
+    results.search_micros.reserve(query_count);
+    results.expand_micros.reserve(query_count);
+
+    for (int query = 0; query < query_count; query++) {
+        entt::entity from { roads[pick_road(rng)] };
+        entt::entity to { tilemap.cells[pick_tile(rng)] };
+        if (from == to)
+            continue;
+
+        path.clear();
+        uint64_t allocations { allocation_count.load() };
+        Clock::time_point start { Clock::now() };
+        int cost { Pathfinding::path_between(registry, from, to, path) };
+        results.search_micros.push_back(micros_since(start));
+        results.search_allocations += allocation_count.load() - allocations;
+        results.queries++;
+
+        reference.search_from(from);
+        int expected { reference.cost_to(to) };
+
+        if (cost == Pathfinding::NO_ROUTE) {
+            if (expected != Pathfinding::NO_ROUTE || !path.empty())
+                results.mismatches++;
+            continue;
+        }
+
+        results.routed++;
+        if (cost != expected || walk_cost(registry, path) != expected)
+            results.mismatches++;
+
+        expanded_path.clear();
+        allocations = allocation_count.load();
+        start = Clock::now();
+        Pathfinding::expand_path(registry, path, expanded_path);
+        results.expand_micros.push_back(micros_since(start));
+        results.expand_allocations += allocation_count.load() - allocations;
+    }
+
+    results.expanded = context.expanded;
+
+    std::printf(
+        "%-6s %5dx%-5d %6zu junctions %s\n",
+        layout.name.c_str(),
+        layout.size,
+        layout.size,
+        registry.view<const JunctionComponent>().size(),
+        registry.ctx().contains<ContractionHierarchy>() ? "(hierarchy)" : "(A*)"
+    );
+    return results;
+}
+
+void report(Results& results)
+{
+    double queries { double(std::max<size_t>(results.queries, 1)) };
+    double routed { double(std::max<size_t>(results.routed, 1)) };
+
+    std::printf(
+        "    %zu queries, %zu routed, %zu mismatches\n"
+        "    search  p50 %8.2fus  p99 %8.2fus  %8.1f expanded  %6.2f allocations per query\n"
+        "    expand  p50 %8.2fus  p99 %8.2fus  %6.2f allocations per path\n",
+        results.queries,
+        results.routed,
+        results.mismatches,
+        percentile(results.search_micros, 0.5),
+        percentile(results.search_micros, 0.99),
+        results.expanded / queries,
+        results.search_allocations / queries,
+        percentile(results.expand_micros, 0.5),
+        percentile(results.expand_micros, 0.99),
+        results.expand_allocations / routed
+    );
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int query_count { argc > 1 ? std::atoi(argv[1]) : 2000 };
+    unsigned seed { argc > 2 ? unsigned(std::atoi(argv[2])) : 1u };
+    std::mt19937 rng { seed };
+
+    std::vector<RoadLayout> layouts;
+    layouts.push_back(grid_layout(64, rng));
+    layouts.push_back(grid_layout(160, rng));
+    layouts.push_back(tree_layout(97, rng));
+    layouts.push_back(ring_layout(101, rng));
+    layouts.push_back(maze_layout(81, rng));
+
+    size_t mismatches { 0 };
+    for (const RoadLayout& layout : layouts) {
+        Results results { run(layout, query_count, rng) };
+        report(results);
+        mismatches += results.mismatches;
+    }
+
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,7 +1,9 @@
 #include <SDL2/SDL.h>
 #include <archive.h>
+#include <cstring>
 #include <entt/entt.hpp>
 #include <fstream>
+#include <functional>
 #include <glm/glm.hpp>
 #include <grid.h>
 #include <json_parse.h>
@@ -95,4 +97,515 @@ void InputArchive::operator()(SpriteComponent& component)
     current_pool.value().components.pop();
     std::string sprite_name { _component["name"].get<std::string>() };
     component.sprite_definition = &spritesheet.sprites.at(sprite_name);
-}
\ No newline at end of file
+}
+
+namespace {
+
+/*
+    SAX handler for the save file, sorting what it's given by where it is:
+    the context and each component are built up as JSON values and passed
+    on once complete, and the pools' sizes and entities are noted as read.
+    Each pass has the handler pick out only what it's after.
+*/
+class SaveFileHandler {
+public:
+    enum class Pass {
+        INDEX,
+        COMPONENTS
+    };
+
+private:
+    Pass pass;
+    nlohmann::json& context;
+    std::vector<StreamingInputArchive::Pool>& pools;
+    std::function<bool(size_t, nlohmann::json&&)> on_component;
+
+    // Nesting outside any value being built: 1 in the root object, 3 in a
+    // pool and 4 in a pool's entities or components
+    int depth { 0 };
+    std::string root_key;
+    std::string pool_key;
+    size_t pool_count { 0 };
+
+    // The value being built, and the path to its innermost open container
+    bool building { false };
+    nlohmann::json value;
+    std::vector<nlohmann::json*> open;
+    std::string value_key;
+
+    bool in_pools() const { return root_key == "component_pools"; }
+
+    nlohmann::json& add(nlohmann::json&& element)
+    {
+        nlohmann::json& container { *open.back() };
+        if (container.is_array()) {
+            container.push_back(std::move(element));
+            return container.back();
+        }
+
+        nlohmann::json& slot { container[value_key] };
+        slot = std::move(element);
+        return slot;
+    }
+
+    // A value is complete; hand it to whoever it's for
+    bool finish()
+    {
+        building = false;
+        if (in_pools())
+            return on_component(pool_count - 1, std::move(value));
+
+        context = std::move(value);
+        return true;
+    }
+
+    bool wanted_here() const
+    {
+        if (depth == 1 && root_key == "context")
+            return pass == Pass::INDEX;
+
+        return depth == 4 && in_pools() && pool_key == "components" && pass == Pass::COMPONENTS;
+    }
+
+    bool scalar(nlohmann::json&& element)
+    {
+        if (building) {
+            add(std::move(element));
+            return true;
+        }
+
+        if (wanted_here()) {
+            value = std::move(element);
+            return finish();
+        }
+
+        if (pass == Pass::INDEX && in_pools() && pool_count > 0) {
+            StreamingInputArchive::Pool& pool { pools.back() };
+            if (depth == 3 && pool_key == "size")
+                pool.size = element.get<std::underlying_type_t<entt::entity>>();
+            else if (depth == 4 && pool_key == "entities")
+                pool.entities.push_back(element.get<entt::entity>());
+        }
+
+        return true;
+    }
+
+    bool start(nlohmann::json&& container)
+    {
+        if (building) {
+            open.push_back(&add(std::move(container)));
+            return true;
+        }
+
+        if (wanted_here()) {
+            building = true;
+            value = std::move(container);
+            open.assign(1, &value);
+            return true;
+        }
+
+        if (depth == 2 && in_pools() && container.is_object()) {
+            pool_count++;
+            pool_key.clear();
+            if (pass == Pass::INDEX)
+                pools.emplace_back();
+        }
+
+        depth++;
+        return true;
+    }
+
+    bool end()
+    {
+        if (building) {
+            open.pop_back();
+            return open.empty() ? finish() : true;
+        }
+
+        depth--;
+        return true;
+    }
+
+public:
+    SaveFileHandler(
+        Pass pass,
+        nlohmann::json& context,
+        std::vector<StreamingInputArchive::Pool>& pools,
+        std::function<bool(size_t, nlohmann::json&&)> on_component
+    )
+        : pass { pass }
+        , context { context }
+        , pools { pools }
+        , on_component { std::move(on_component) }
+    {
+    }
+
+    bool null() { return scalar(nullptr); }
+    bool boolean(bool element) { return scalar(element); }
+    bool number_integer(nlohmann::json::number_integer_t element) { return scalar(element); }
+    bool number_unsigned(nlohmann::json::number_unsigned_t element) { return scalar(element); }
+    bool number_float(nlohmann::json::number_float_t element, const nlohmann::json::string_t&) { return scalar(element); }
+    bool string(nlohmann::json::string_t& element) { return scalar(std::move(element)); }
+    bool binary(nlohmann::json::binary_t& element) { return scalar(nlohmann::json::binary(std::move(element))); }
+
+    bool start_object(std::size_t) { return start(nlohmann::json::object()); }
+    bool end_object() { return end(); }
+    bool start_array(std::size_t) { return start(nlohmann::json::array()); }
+    bool end_array() { return end(); }
+
+    bool key(nlohmann::json::string_t& element)
+    {
+        if (building)
+            value_key = element;
+        else if (depth == 1)
+            root_key = element;
+        else if (depth == 3)
+            pool_key = element;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::json::exception& error)
+    {
+        spdlog::error("Save file unreadable at byte {}: {}", position, error.what());
+        return false;
+    }
+};
+}
+
+StreamingInputArchive::StreamingInputArchive(std::string file_path, const SpriteSheet& spritesheet)
+    : spritesheet { spritesheet }
+    , file_path { file_path }
+{
+    std::ifstream ifs(file_path);
+    SaveFileHandler index {
+        SaveFileHandler::Pass::INDEX,
+        context,
+        pools,
+        [](size_t, nlohmann::json&&) { return true; }
+    };
+    nlohmann::json::sax_parse(ifs, &index);
+
+    parser = std::thread { &StreamingInputArchive::parse_components, this };
+}
+
+StreamingInputArchive::~StreamingInputArchive()
+{
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        cancelled = true;
+    }
+    space_ready.notify_all();
+    parser.join();
+}
+
+void StreamingInputArchive::parse_components()
+{
+    std::ifstream ifs(file_path);
+    nlohmann::json unused_context;
+    std::vector<Pool> unused_pools;
+    SaveFileHandler stream {
+        SaveFileHandler::Pass::COMPONENTS,
+        unused_context,
+        unused_pools,
+        [this](size_t pool, nlohmann::json&& value) { return push_component(pool, std::move(value)); }
+    };
+    nlohmann::json::sax_parse(ifs, &stream);
+
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        finished = true;
+    }
+    component_ready.notify_all();
+}
+
+// Queue a parsed component, waiting for room; false stops the parse
+bool StreamingInputArchive::push_component(size_t pool, nlohmann::json&& value)
+{
+    {
+        std::unique_lock<std::mutex> lock { mutex };
+        space_ready.wait(lock, [this]() { return cancelled || components.size() < STREAM_CAPACITY; });
+        if (cancelled)
+            return false;
+
+        components.push_back({ pool, std::move(value) });
+    }
+    component_ready.notify_one();
+    return true;
+}
+
+// The next component of the current pool, skipping any the loader passed over
+nlohmann::json StreamingInputArchive::next_component()
+{
+    nlohmann::json value;
+    {
+        std::unique_lock<std::mutex> lock { mutex };
+        while (true) {
+            component_ready.wait(lock, [this]() { return finished || !components.empty(); });
+            if (components.empty()) {
+                spdlog::error("{} ran out of components in pool {}", file_path, current_pool);
+                return value;
+            }
+
+            Component& front { components.front() };
+            if (front.pool > current_pool) {
+                spdlog::error("{} ran out of components in pool {}", file_path, current_pool);
+                return value;
+            }
+
+            const bool wanted { front.pool == current_pool };
+            if (wanted)
+                value = std::move(front.value);
+            components.pop_front();
+
+            if (wanted)
+                break;
+        }
+    }
+    space_ready.notify_one();
+    return value;
+}
+
+void StreamingInputArchive::operator()(std::underlying_type_t<entt::entity>& size)
+{
+    current_pool = next_pool++;
+    next_entity = 0;
+    size = current_pool < pools.size() ? pools[current_pool].size : 0;
+}
+
+void StreamingInputArchive::operator()(entt::entity& entity)
+{
+    const std::vector<entt::entity>& entities { pools.at(current_pool).entities };
+    entity = next_entity < entities.size() ? entities[next_entity++] : entt::entity { entt::null };
+}
+
+void StreamingInputArchive::operator()(SpriteComponent& component)
+{
+    // can't use brace initialisation here
+    nlohmann::json _component = next_component();
+    std::string sprite_name { _component["name"].get<std::string>() };
+    component.sprite_definition = &spritesheet.sprites.at(sprite_name);
+}
+
+void BinaryOutputArchive::operator()(entt::entity entity)
+{
+    pools.back().entities.push_back(entity);
+}
+
+void BinaryOutputArchive::operator()(std::underlying_type_t<entt::entity> size)
+{
+    pools.push_back({ size, 0, false, {}, {} });
+}
+
+void BinaryOutputArchive::operator()(const SpriteComponent& component)
+{
+    pools.back().component_size = sizeof(uint32_t);
+    pools.back().sprite_indices = true;
+    const std::string& name { component.sprite_definition->name };
+    auto [it, inserted] { string_indices.try_emplace(name, static_cast<uint32_t>(strings.size())) };
+    if (inserted)
+        strings.push_back(name);
+
+    BinaryArchive::write(pools.back().components, it->second);
+}
+
+void BinaryOutputArchive::to_file(std::string path)
+{
+    std::vector<char> buffer;
+
+    BinaryArchive::Header header {};
+    std::memcpy(header.magic, BinaryArchive::MAGIC, sizeof(header.magic));
+    header.version = BinaryArchive::VERSION;
+    header.pool_count = static_cast<uint32_t>(pools.size());
+    header.string_count = static_cast<uint32_t>(strings.size());
+    header.context_count = static_cast<uint32_t>(context.size());
+    BinaryArchive::write(buffer, header);
+
+    for (const Pool& pool : pools) {
+        BinaryArchive::write(
+            buffer,
+            BinaryArchive::PoolHeader {
+                pool.size,
+                static_cast<uint32_t>(pool.entities.size()),
+                pool.component_size,
+                pool.sprite_indices,
+                pool.components.size()
+            }
+        );
+    }
+
+    for (const std::string& name : strings) {
+        BinaryArchive::write(buffer, name);
+    }
+
+    for (const auto& [key, element] : context) {
+        BinaryArchive::write(buffer, key);
+        BinaryArchive::write(buffer, element);
+    }
+
+    for (const Pool& pool : pools) {
+        const char* entities { reinterpret_cast<const char*>(pool.entities.data()) };
+        buffer.insert(buffer.end(), entities, entities + pool.entities.size() * sizeof(entt::entity));
+        buffer.insert(buffer.end(), pool.components.begin(), pool.components.end());
+    }
+
+    std::ofstream file { path, std::ios::binary };
+    file.write(buffer.data(), buffer.size());
+}
+
+BinaryInputArchive::BinaryInputArchive(std::string file_path, const SpriteSheet& spritesheet)
+    : spritesheet { spritesheet }
+{
+    std::ifstream file { file_path, std::ios::binary | std::ios::ate };
+    if (!file)
+        return;
+
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+
+    const char* cursor { data.data() };
+    const char* const end { data.data() + data.size() };
+
+    // Whether the bytes are there to read, complaining if not
+    auto fits { [&cursor, end, &file_path](uint64_t bytes) {
+        if (bytes <= uint64_t(end - cursor))
+            return true;
+        spdlog::warn("{} is truncated", file_path);
+        return false;
+    } };
+
+    // Reads complaining if the file ends first
+    auto read { [&cursor, end, &file_path](auto& value) {
+        if (BinaryArchive::read(cursor, end, value))
+            return true;
+        spdlog::warn("{} is truncated", file_path);
+        return false;
+    } };
+
+    BinaryArchive::Header header {};
+    if (!read(header))
+        return;
+
+    if (std::memcmp(header.magic, BinaryArchive::MAGIC, sizeof(header.magic)) != 0) {
+        spdlog::warn("{} isn't a binary save", file_path);
+        return;
+    }
+
+    if (header.version != BinaryArchive::VERSION) {
+        spdlog::warn("{} is version {} of the save format, not {}", file_path, header.version, BinaryArchive::VERSION);
+        return;
+    }
+
+    std::vector<BinaryArchive::PoolHeader> pool_headers(header.pool_count);
+    if (!fits(uint64_t { header.pool_count } * sizeof(BinaryArchive::PoolHeader)))
+        return;
+    for (auto& pool_header : pool_headers) {
+        read(pool_header);
+    }
+
+    std::string name;
+    for (uint32_t index = 0; index < header.string_count; index++) {
+        if (!read(name))
+            return;
+
+        auto sprite { spritesheet.sprites.find(name) };
+        if (sprite == spritesheet.sprites.end()) {
+            spdlog::warn("{} uses sprite {}, which isn't in the spritesheet", file_path, name);
+            return;
+        }
+        sprites.push_back(&sprite->second);
+    }
+
+    std::string key;
+    for (uint32_t index = 0; index < header.context_count; index++) {
+        uint64_t element_size { 0 };
+        if (!read(key) || !read(element_size) || !fits(element_size))
+            return;
+
+        context[key] = { cursor, cursor + element_size };
+        cursor += element_size;
+    }
+
+    for (const auto& pool_header : pool_headers) {
+        const uint64_t entity_bytes { uint64_t { pool_header.entity_count } * sizeof(entt::entity) };
+        if (pool_header.component_bytes != uint64_t { pool_header.entity_count } * pool_header.component_size) {
+            spdlog::warn("{} has {} bytes of components for {} entities", file_path, pool_header.component_bytes, pool_header.entity_count);
+            return;
+        }
+
+        if (!fits(entity_bytes + pool_header.component_bytes))
+            return;
+
+        const char* components { cursor + entity_bytes };
+        const char* components_end { components + pool_header.component_bytes };
+
+        // Sprite components are checked up front, as there's no sprite to
+        // give one that names none
+        if (pool_header.sprite_indices) {
+            const char* component { components };
+            uint32_t sprite { 0 };
+            bool named { pool_header.component_size == sizeof(sprite) };
+            while (named && component != components_end) {
+                named = BinaryArchive::read(component, components_end, sprite) && sprite < sprites.size();
+            }
+
+            if (!named) {
+                spdlog::warn("{} has a sprite component naming no sprite", file_path);
+                return;
+            }
+        }
+
+        pools.push_back({ pool_header.size, pool_header.component_size, cursor, components, components, components_end });
+        cursor = components_end;
+    }
+
+    loaded = true;
+}
+
+BinaryInputArchive::Pool* BinaryInputArchive::pool_with(size_t component_size)
+{
+    if (next_pool == 0 || next_pool > pools.size()) {
+        spdlog::error("Binary save has no pool {} to load from", next_pool);
+        return nullptr;
+    }
+
+    Pool& pool { pools[next_pool - 1] };
+    if (pool.component_size != component_size || size_t(pool.components_end - pool.components) < component_size) {
+        spdlog::error("Binary save pool {} has no component of {} bytes left", next_pool - 1, component_size);
+        return nullptr;
+    }
+
+    return &pool;
+}
+
+void BinaryInputArchive::operator()(std::underlying_type_t<entt::entity>& size)
+{
+    if (next_pool >= pools.size()) {
+        spdlog::error("Binary save has only {} pools", pools.size());
+        size = 0;
+        return;
+    }
+
+    size = pools[next_pool++].size;
+}
+
+void BinaryInputArchive::operator()(entt::entity& entity)
+{
+    Pool* pool { next_pool > 0 && next_pool <= pools.size() ? &pools[next_pool - 1] : nullptr };
+    if (!pool || pool->entities == pool->entities_end) {
+        spdlog::error("Binary save ran out of entities in pool {}", next_pool - 1);
+        entity = entt::null;
+        return;
+    }
+
+    BinaryArchive::read(pool->entities, pool->entities_end, entity);
+}
+
+void BinaryInputArchive::operator()(SpriteComponent& component)
+{
+    // Indices were checked against the sprites when the file was read
+    uint32_t index { 0 };
+    Pool* pool { pool_with(sizeof(index)) };
+    if (pool && BinaryArchive::read(pool->components, pool->components_end, index) && index < sprites.size())
+        component.sprite_definition = sprites[index];
+}
@@ -2,16 +2,26 @@
 #define ARCHIVE_H
 
 #include <SDL2/SDL.h>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <entt/entt.hpp>
 #include <glm/glm.hpp>
+#include <grid.h>
 #include <json_parse.h>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <queue>
+#include <segment_arena.h>
 #include <spritesheet.h>
 #include <string>
 #include <spdlog/spdlog.h>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include <components/sprite_component.h>
 
@@ -134,6 +144,324 @@ public:
     {
         context.at(document_key).get_to(element);
     }
+
+    bool has_context_element(const std::string document_key) const
+    {
+        return context.contains(document_key);
+    }
+};
+
+/*
+    Reads the same JSON as InputArchive without holding the document: the
+    file is parsed with a SAX handler, once to pick out the context and each
+    pool's size and entities, and then on a thread of its own to hand each
+    component over as it is parsed. The loader waits on the parser, and the
+    parser on the loader once STREAM_CAPACITY components are waiting.
+
+    Pools list their components ahead of their entities, which is why the
+    entities are gathered by the first pass; they are all that is kept of
+    the pools.
+*/
+class StreamingInputArchive {
+public:
+    static constexpr size_t STREAM_CAPACITY { 256 };
+
+    struct Pool {
+        std::underlying_type_t<entt::entity> size { 0 };
+        std::vector<entt::entity> entities;
+    };
+
+    // A component and the pool it was listed in
+    struct Component {
+        size_t pool;
+        nlohmann::json value;
+    };
+
+private:
+    const SpriteSheet& spritesheet;
+    std::string file_path;
+    nlohmann::json context;
+    std::vector<Pool> pools;
+    size_t next_pool { 0 };
+    size_t current_pool { 0 };
+    size_t next_entity { 0 };
+
+    std::mutex mutex;
+    std::condition_variable component_ready;
+    std::condition_variable space_ready;
+    std::deque<Component> components;
+    bool finished { false };
+    bool cancelled { false };
+    std::thread parser;
+
+    void parse_components();
+    bool push_component(size_t pool, nlohmann::json&& value);
+    nlohmann::json next_component();
+
+public:
+    StreamingInputArchive(std::string file_path, const SpriteSheet& spritesheet);
+    ~StreamingInputArchive();
+
+    StreamingInputArchive(const StreamingInputArchive&) = delete;
+    StreamingInputArchive& operator=(const StreamingInputArchive&) = delete;
+
+    void operator()(entt::entity&);
+    void operator()(std::underlying_type_t<entt::entity>&);
+
+    template <typename T>
+    void operator()(T& component)
+    {
+        T _component { next_component().get<T>() };
+        component = _component;
+    }
+
+    void operator()(SpriteComponent& component);
+
+    template <typename T>
+    void load_context_element(const std::string document_key, T& element) const
+    {
+        context.at(document_key).get_to(element);
+    }
+
+    bool has_context_element(const std::string document_key) const
+    {
+        return context.contains(document_key);
+    }
+};
+
+/*
+    The same snapshot in binary, for the game's own saves; the JSON archives
+    above remain for saves meant to be read or edited by hand.
+
+    The file starts with a header giving the format version and the number
+    of pools, sprite names and context elements, followed by:
+        - a size, entity count, component size and component byte count for
+          each pool, and whether its components are sprite name indices;
+        - the sprite names, which sprite components are saved as indices of;
+        - each context element, by key;
+        - each pool's entities and then its components, packed.
+
+    Components are copied byte for byte, so must be trivially copyable, and
+    the file is in the byte order of the machine that saved it.
+*/
+namespace BinaryArchive {
+
+inline constexpr char MAGIC[4] { 'I', 'S', 'O', 'S' };
+// Bump whenever the layout, or that of a saved component, changes
+inline constexpr uint32_t VERSION { 2 };
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t pool_count;
+    uint32_t string_count;
+    uint32_t context_count;
+};
+
+struct PoolHeader {
+    uint32_t size;
+    uint32_t entity_count;
+    // sizeof the saved component, 0 for the pool of entities only
+    uint32_t component_size;
+    uint32_t sprite_indices;
+    uint64_t component_bytes;
+};
+
+template <typename T>
+void write(std::vector<char>& buffer, const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "Saved in binary by copying its bytes");
+    const char* bytes { reinterpret_cast<const char*>(&value) };
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+void write(std::vector<char>& buffer, const std::vector<T>& values)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "Saved in binary by copying its bytes");
+    write(buffer, uint64_t { values.size() });
+    const char* bytes { reinterpret_cast<const char*>(values.data()) };
+    buffer.insert(buffer.end(), bytes, bytes + values.size() * sizeof(T));
+}
+
+inline void write(std::vector<char>& buffer, const std::string& value)
+{
+    write(buffer, uint32_t(value.size()));
+    buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+template <typename StoredType, typename Projection>
+void write(std::vector<char>& buffer, const Grid<StoredType, Projection>& grid)
+{
+    write(buffer, grid.cells);
+    write(buffer, grid.cell_size);
+    write(buffer, grid.grid_dimensions);
+}
+
+inline void write(std::vector<char>& buffer, const SegmentArena& arena)
+{
+    write(buffer, arena.members);
+    write(buffer, uint64_t { arena.released });
+}
+
+// Reads advance the cursor past what they read, and fail without reading
+// anything past the end
+template <typename T>
+bool read(const char*& cursor, const char* end, T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "Saved in binary by copying its bytes");
+    if (size_t(end - cursor) < sizeof(T))
+        return false;
+
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return true;
+}
+
+template <typename T>
+bool read(const char*& cursor, const char* end, std::vector<T>& values)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "Saved in binary by copying its bytes");
+    uint64_t size { 0 };
+    if (!read(cursor, end, size) || size > size_t(end - cursor) / sizeof(T))
+        return false;
+
+    values.resize(size);
+    std::memcpy(values.data(), cursor, size * sizeof(T));
+    cursor += size * sizeof(T);
+    return true;
+}
+
+inline bool read(const char*& cursor, const char* end, std::string& value)
+{
+    uint32_t size { 0 };
+    if (!read(cursor, end, size) || size > size_t(end - cursor))
+        return false;
+
+    value.assign(cursor, size);
+    cursor += size;
+    return true;
+}
+
+template <typename StoredType, typename Projection>
+bool read(const char*& cursor, const char* end, Grid<StoredType, Projection>& grid)
+{
+    if (
+        !read(cursor, end, grid.cells)
+        || !read(cursor, end, grid.cell_size)
+        || !read(cursor, end, grid.grid_dimensions)
+    )
+        return false;
+
+    grid.area = grid.cell_size * grid.grid_dimensions;
+    return true;
+}
+
+inline bool read(const char*& cursor, const char* end, SegmentArena& arena)
+{
+    uint64_t released { 0 };
+    if (!read(cursor, end, arena.members) || !read(cursor, end, released))
+        return false;
+
+    arena.released = released;
+    return true;
+}
+}
+
+class BinaryOutputArchive {
+    struct Pool {
+        uint32_t size;
+        uint32_t component_size;
+        bool sprite_indices;
+        std::vector<entt::entity> entities;
+        std::vector<char> components;
+    };
+
+    std::vector<Pool> pools;
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> string_indices;
+    std::vector<std::pair<std::string, std::vector<char>>> context;
+
+public:
+    void operator()(entt::entity entity);
+    void operator()(std::underlying_type_t<entt::entity> size);
+
+    template <typename T>
+    void operator()(const T& component)
+    {
+        pools.back().component_size = sizeof(T);
+        BinaryArchive::write(pools.back().components, component);
+    }
+
+    void operator()(const SpriteComponent& component);
+
+    template <typename T>
+    void save_context_element(const std::string document_key, const T& element)
+    {
+        context.emplace_back(document_key, std::vector<char> {});
+        BinaryArchive::write(context.back().second, element);
+    }
+
+    void to_file(std::string path);
+};
+
+class BinaryInputArchive {
+    // Cursors into the file, with the end of each run
+    struct Pool {
+        uint32_t size;
+        uint32_t component_size;
+        const char* entities;
+        const char* entities_end;
+        const char* components;
+        const char* components_end;
+    };
+
+    const SpriteSheet& spritesheet;
+    // The whole file, read at once; everything else points into it
+    std::vector<char> data;
+    std::vector<Pool> pools;
+    std::vector<const SpriteDefinition*> sprites;
+    // Each context element's bytes
+    std::unordered_map<std::string, std::pair<const char*, const char*>> context;
+    size_t next_pool { 0 };
+    bool loaded { false };
+
+    // The pool being loaded if it has another T left, complaining if not
+    Pool* pool_with(size_t component_size);
+
+public:
+    BinaryInputArchive(std::string file_path, const SpriteSheet& spritesheet);
+
+    // Whether the file could be read and is of this version of the format
+    bool valid() const { return loaded; }
+
+    void operator()(entt::entity&);
+    void operator()(std::underlying_type_t<entt::entity>&);
+
+    template <typename T>
+    void operator()(T& component)
+    {
+        if (Pool* pool { pool_with(sizeof(T)) })
+            BinaryArchive::read(pool->components, pool->components_end, component);
+    }
+
+    void operator()(SpriteComponent& component);
+
+    // An element that runs past its bytes leaves the archive invalid
+    template <typename T>
+    void load_context_element(const std::string document_key, T& element)
+    {
+        auto [cursor, end] { context.at(document_key) };
+        if (!BinaryArchive::read(cursor, end, element)) {
+            spdlog::error("Binary save context element {} is corrupt", document_key);
+            loaded = false;
+        }
+    }
+
+    bool has_context_element(const std::string document_key) const
+    {
+        return context.count(document_key);
+    }
 };
 
 #endif
@@ -7,6 +7,7 @@ struct SpatialMapEntityCreateFlag { };
 struct SpatialMapEntityDeleteFlag { };
 struct ConnectivityUpdateFlag { };
 struct SegmentDeleteFlag { };
+struct PassabilityUpdateFlag { };
 struct DebugFlag { };
 struct SenderFlag { };
 struct ReceiverFlag { };
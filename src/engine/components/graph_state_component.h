@@ -0,0 +1,56 @@
+#ifndef GRAPHSTATECOMPONENT_H
+#define GRAPHSTATECOMPONENT_H
+
+#include <constants.h>
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <vector>
+
+// What the latest change to the road graph did. A junction is modified when
+// its segments or network label changed; a segment when its network did.
+struct GraphChanges {
+    std::vector<entt::entity> added_junctions;
+    std::vector<entt::entity> removed_junctions;
+    std::vector<entt::entity> modified_junctions;
+    std::vector<entt::entity> added_segments;
+    std::vector<entt::entity> removed_segments;
+    std::vector<entt::entity> modified_segments;
+
+    void clear()
+    {
+        added_junctions.clear();
+        removed_junctions.clear();
+        modified_junctions.clear();
+        added_segments.clear();
+        removed_segments.clear();
+        modified_segments.clear();
+    }
+};
+
+struct GraphStateComponent {
+    // Bumped each time GraphSystem rebuilds or patches the road graph
+    uint64_t generation { 0 };
+    // Tiles whose connectivity changed in the latest rebuild
+    std::vector<entt::entity> changed_tiles;
+    // The graph's changes in the same rebuild. Only those of the latest
+    // generation are kept, so a reader that missed one must assume
+    // everything changed.
+    GraphChanges changes;
+    // Next unused road network label; see JunctionComponent::network
+    uint32_t next_network { 0 };
+    // Full rebuilds run this long a frame, keeping the previous graph until
+    // done; zero rebuilds within the frame
+    float rebuild_budget_millis { Constants::GRAPH_REBUILD_BUDGET_MILLIS };
+    // Fraction of a full rebuild in progress done; one when none is
+    float rebuild_progress { 1.f };
+    // Local patches drop the landmarks and contraction hierarchy rather than
+    // work them out for every edit; they come back once the graph has gone
+    // GRAPH_SETTLE_FRAMES without a change
+    bool hierarchy_stale { false };
+    uint32_t settled_frames { 0 };
+    // Debug: compare each local rebuild with what a full rebuild would give
+    bool check_rebuilds { false };
+    uint64_t check_failures { 0 };
+};
+
+#endif
@@ -2,14 +2,27 @@
 #define JUNCTIONCOMPONENT_H
 
 #include <array>
+#include <cstdint>
 #include <entt/entt.hpp>
 #include <nlohmann/json.hpp>
 
 struct JunctionComponent {
     std::array<entt::entity, 4> connections;
-    JunctionComponent() { connections.fill(entt::null); }
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(JunctionComponent, connections)
+    // Dense position of the junction, reassigned each time the graph is computed
+    uint32_t index;
+
+    // Label shared by every junction on the same connected road network
+    uint32_t network;
+
+    JunctionComponent()
+        : index { 0 }
+        , network { 0 }
+    {
+        connections.fill(entt::null);
+    }
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(JunctionComponent, connections, index, network)
 };
 
 #endif
\ No newline at end of file
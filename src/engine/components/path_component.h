@@ -4,6 +4,7 @@
 #include <directions.h>
 #include <entt/entt.hpp>
 #include <glm/glm.hpp>
+#include <route_store.h>
 #include <vector>
 
 struct PathSegment {
@@ -18,9 +19,24 @@ struct PathSegment {
     }
 };
 
+// Where a walker is along its route: the route tile it is leaving, and
+// whether it has already crossed the junction on that tile
+struct RouteCursor {
+    size_t leg { 0 };
+    bool crossed { false };
+};
+
+/*
+    A walker's route as the tiles it turns at - the source tile, each junction
+    crossed and the goal tile - shared with every walker on the same trip.
+    Only the segment being walked is kept; the next is generated from the
+    route when the walker reaches its end (see Pathfinding::next_segment).
+*/
 struct PathComponent {
-    std::vector<PathSegment> path;
-    size_t current { 0 };
+    Route route;
+    PathSegment segment;
+    RouteCursor cursor;
+    bool finished { false };
 };
 
 #endif
\ No newline at end of file
@@ -1,17 +1,32 @@
 #ifndef SEGMENTCOMPONENT_H
 #define SEGMENTCOMPONENT_H
 
-#include <algorithm>
+#include <cstdint>
 #include <directions.h>
 #include <entt/entt.hpp>
 #include <nlohmann/json.hpp>
-#include <vector>
+
+// A segment's run of member tiles in the SegmentArena
+struct SegmentMembers {
+    uint32_t offset { 0 };
+    uint32_t count { 0 };
+
+    uint32_t size() const { return count; }
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(SegmentMembers, offset, count)
+};
 
 struct SegmentComponent {
     entt::entity origin;
     entt::entity termination;
     Direction::TDirection direction;
-    std::vector<entt::entity> entities;
+    // The tiles between the junctions, in order from the origin
+    SegmentMembers members;
+    // Steps walking from one end to the other; crossing the junctions at
+    // either end is charged by the search
+    int cost;
+    // The road network of the junctions at either end
+    uint32_t network;
 
     SegmentComponent(const SegmentComponent&) = default;
     SegmentComponent(SegmentComponent&&) = default;
@@ -22,7 +37,9 @@ struct SegmentComponent {
         : origin { entt::null }
         , termination { entt::null }
         , direction { Direction::TDirection::NO_DIRECTION }
-        , entities {}
+        , members {}
+        , cost { 0 }
+        , network { 0 }
     {
     }
 
@@ -30,38 +47,23 @@ struct SegmentComponent {
         entt::entity origin,
         entt::entity termination,
         Direction::TDirection direction,
-        std::vector<entt::entity> entities
+        SegmentMembers members
     )
         : origin { origin }
         , termination { termination }
         , direction { direction }
-        , entities { entities }
-    {
-    }
-
-    SegmentComponent(const std::vector<entt::entity>& _entities, Direction::TDirection direction)
-        : origin { _entities.front() }
-        , termination { _entities.back() }
-        , direction { direction }
-        , entities {}
+        , members { members }
+        , cost { 0 }
+        , network { 0 }
     {
-        entities.reserve(_entities.size());
-        std::copy_if(
-            _entities.begin(),
-            _entities.end(),
-            std::back_inserter(entities),
-            [_entities](entt::entity x) {
-                return x != _entities.front() && x != _entities.back();
-            }
-        );
     }
 
     bool operator<(const SegmentComponent& comparator) const
     {
-        return entities.size() < comparator.entities.size();
+        return members.size() < comparator.members.size();
     }
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(SegmentComponent, origin, termination, direction, entities)
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(SegmentComponent, origin, termination, direction, members, cost, network)
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef UNROUTABLECOMPONENT_H
+#define UNROUTABLECOMPONENT_H
+
+#include <cstdint>
+#include <entt/entt.hpp>
+
+// A sender whose last search found no way to its receiver; not searched
+// again until the road graph has changed since
+struct UnroutableComponent {
+    entt::entity receiver;
+    uint64_t generation;
+};
+
+#endif
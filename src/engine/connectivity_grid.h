@@ -0,0 +1,105 @@
+#ifndef CONNECTIVITYGRID_H
+#define CONNECTIVITYGRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <directions.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+/*
+    The directions of every tile's ConnectivityComponent, packed a nibble per
+    tile and sixteen tiles to a word, row by row; tiles without connectivity
+    are zero. Kept up to date by GraphSystem from the connectivity flags.
+
+    Rows are padded to whole words, and the padding stays zero, so a word can
+    be compared with the words beside, above and below it to resolve sixteen
+    tiles' connections at once.
+*/
+struct ConnectivityGrid {
+    static constexpr int TILES_PER_WORD { 16 };
+
+    // One bit of each nibble, by direction
+    static constexpr uint64_t NORTH_BITS { 0x1111111111111111 };
+    static constexpr uint64_t WEST_BITS { NORTH_BITS << 1 };
+    static constexpr uint64_t SOUTH_BITS { NORTH_BITS << 2 };
+    static constexpr uint64_t EAST_BITS { NORTH_BITS << 3 };
+
+    glm::ivec2 dimensions {};
+    int row_words { 0 };
+    std::vector<uint64_t> words;
+
+    void resize(glm::ivec2 map_dimensions)
+    {
+        dimensions = map_dimensions;
+        row_words = (dimensions.x + TILES_PER_WORD - 1) / TILES_PER_WORD;
+        words.assign(size_t(row_words) * dimensions.y, 0);
+    }
+
+    bool contains(glm::ivec2 position) const
+    {
+        return position.x >= 0 && position.y >= 0 && position.x < dimensions.x && position.y < dimensions.y;
+    }
+
+    // Tiles off the map have no connectivity
+    Direction::TDirection at(glm::ivec2 position) const
+    {
+        if (!contains(position))
+            return Direction::TDirection::NO_DIRECTION;
+
+        uint64_t word { words[size_t(position.y) * row_words + position.x / TILES_PER_WORD] };
+        return static_cast<Direction::TDirection>((word >> (4 * (position.x % TILES_PER_WORD))) & 0xF);
+    }
+
+    void set(glm::ivec2 position, Direction::TDirection directions)
+    {
+        uint64_t& word { words[size_t(position.y) * row_words + position.x / TILES_PER_WORD] };
+        int shift { 4 * (position.x % TILES_PER_WORD) };
+        word = (word & ~(uint64_t { 0xF } << shift))
+            | (uint64_t(Direction::to_underlying(directions) & 0xF) << shift);
+    }
+
+    // Whether the tile connects in the direction and the tile there connects back
+    bool reciprocate(glm::ivec2 position, Direction::TDirection direction) const
+    {
+        return (
+            Direction::any(at(position) & direction)
+            && Direction::any(at(position + Direction::direction_vectors.at(direction)) & Direction::reverse(direction))
+        );
+    }
+
+    // The reciprocated directions of the sixteen tiles in a word
+    uint64_t resolved(size_t word_index) const
+    {
+        const size_t column { word_index % row_words };
+        const uint64_t word { words[word_index] };
+        const uint64_t previous { column > 0 ? words[word_index - 1] : 0 };
+        const uint64_t next { column + 1 < size_t(row_words) ? words[word_index + 1] : 0 };
+        const uint64_t above { word_index >= size_t(row_words) ? words[word_index - row_words] : 0 };
+        const uint64_t below { word_index + row_words < words.size() ? words[word_index + row_words] : 0 };
+
+        // Each tile's neighbours, shifted into the tile's own nibble
+        const uint64_t east { (word >> 4) | (next << 60) };
+        const uint64_t west { (word << 4) | (previous >> 60) };
+
+        return (word & ((above & SOUTH_BITS) >> 2))
+            | (word & ((below & NORTH_BITS) << 2))
+            | (word & ((east & WEST_BITS) << 2))
+            | (word & ((west & EAST_BITS) >> 2));
+    }
+
+    // The lowest bit of each nibble that is set, as Direction::is_junction;
+    // every nibble but empty, north-south and east-west is a junction
+    static uint64_t junction_nibbles(uint64_t word)
+    {
+        auto nonzero { [](uint64_t nibbles) {
+            return (nibbles | (nibbles >> 1) | (nibbles >> 2) | (nibbles >> 3)) & NORTH_BITS;
+        } };
+
+        return nonzero(word)
+            & nonzero(word ^ (NORTH_BITS | SOUTH_BITS))
+            & nonzero(word ^ (WEST_BITS | EAST_BITS));
+    }
+};
+
+#endif
@@ -36,8 +36,32 @@ inline constexpr glm::ivec2 SCENE_BORDER_PX { 150, 150 };
 inline constexpr int ROAD_WIDTH_PX { 68 };
 // inline constexpr glm::ivec2 ROAD_MARK_OFFSET { ROAD_WIDTH_PX / 4, ROAD_WIDTH_PX / 8 };
 inline constexpr glm::ivec2 ROAD_MARK_OFFSET { 20, 10 };
+// Extra cost of walking through a junction rather than along a segment
+inline constexpr int JUNCTION_CROSSING_COST { 1 };
+// Below this many junctions a direct search beats the cost of contracting
+inline constexpr size_t HIERARCHY_MIN_JUNCTIONS { 512 };
+// Past this many changed tiles, rebuilding the whole road graph beats patching it
+inline constexpr size_t LOCAL_REBUILD_MAX_TILES { 256 };
+// Time a frame may spend on a full road graph rebuild; zero rebuilds at once
+inline constexpr float GRAPH_REBUILD_BUDGET_MILLIS { 4.f };
+inline constexpr size_t PATH_CACHE_CAPACITY { 1024 };
+// Landmarks bounding A*; each costs a Dijkstra per rebuild and a lookup per estimate
+inline constexpr size_t LANDMARK_COUNT { 8 };
+// Frames the road graph must go unpatched before its landmarks and contraction
+// hierarchy, dropped by local patches, are worked out again
+inline constexpr uint32_t GRAPH_SETTLE_FRAMES { 30 };
+// Searching back from a receiver pays off once this many senders wait on it
+inline constexpr int FLOW_FIELD_MIN_SENDERS { 4 };
+// Search time given each frame to senders that had no route before a rebuild
+inline constexpr float RETRY_BUDGET_MICROS { 2'000.f };
 const std::string spritesheet { "assets/spritesheet_scaled.png" };
 const std::string SAVE_FILE_PATH { "save.json" };
+// Loaded in preference to the JSON save, which is only read without one
+const std::string BINARY_SAVE_FILE_PATH { "save.bin" };
+// Also write the JSON save on exit, to read or edit by hand
+inline constexpr bool EXPORT_JSON_SAVE { false };
+// Parse the JSON save as it's loaded rather than reading it whole first
+inline constexpr bool STREAM_JSON_SAVE { true };
 
 inline std::unordered_map<Direction::TDirection, std::string> WALKER_DIRECTIONS //
     { { { Direction::TDirection::NORTH, "walker_n" },
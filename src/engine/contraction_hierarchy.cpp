@@ -0,0 +1,382 @@
+#include <algorithm>
+#include <constants.h>
+#include <contraction_hierarchy.h>
+#include <entt/entt.hpp>
+#include <functional>
+#include <limits>
+#include <pathfinding.h>
+#include <pathfinding_context.h>
+#include <queue>
+#include <road_graph.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t NO_NODE { ContractionHierarchy::NO_NODE };
+constexpr int UNREACHED { std::numeric_limits<int>::max() };
+
+// Witness searches give up after settling this many junctions; a missed
+// witness only costs a redundant shortcut, never a wrong answer
+constexpr int WITNESS_SETTLE_LIMIT { 64 };
+
+using Arc = ContractionHierarchy::Edge;
+using Adjacency = std::vector<std::vector<Arc>>;
+using QueueEntry = std::pair<int, uint32_t>;
+using MinQueue = std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>>;
+
+void add_arc(std::vector<Arc>& arcs, uint32_t target, int cost, uint32_t middle)
+{
+    for (Arc& arc : arcs) {
+        if (arc.target != target)
+            continue;
+
+        if (cost < arc.cost) {
+            arc.cost = cost;
+            arc.middle = middle;
+        }
+        return;
+    }
+
+    arcs.push_back({ target, cost, middle });
+}
+
+struct Shortcut {
+    uint32_t from;
+    uint32_t to;
+    int cost;
+};
+
+class Contractor {
+    Adjacency& adjacency;
+    std::vector<bool> contracted;
+    std::vector<int> deleted_neighbours;
+
+    // Witness search state, reset by bumping the stamp rather than clearing
+    std::vector<int> distance;
+    std::vector<uint32_t> stamp;
+    uint32_t current_stamp { 0 };
+
+    int witness_distance(uint32_t node) const
+    {
+        return stamp[node] == current_stamp ? distance[node] : UNREACHED;
+    }
+
+    void witness_search(uint32_t source, uint32_t excluded, int limit)
+    {
+        current_stamp++;
+        MinQueue frontier;
+        distance[source] = 0;
+        stamp[source] = current_stamp;
+        frontier.push({ 0, source });
+
+        int settled { 0 };
+        while (!frontier.empty() && settled < WITNESS_SETTLE_LIMIT) {
+            auto [cost, node] { frontier.top() };
+            frontier.pop();
+
+            if (cost > witness_distance(node))
+                continue;
+
+            if (cost > limit)
+                break;
+
+            settled++;
+            // Witnesses cross every junction along them but the first
+            const int crossing { node == source ? 0 : Constants::JUNCTION_CROSSING_COST };
+            for (const Arc& arc : adjacency[node]) {
+                if (arc.target == excluded || contracted[arc.target])
+                    continue;
+
+                int next_cost { cost + crossing + arc.cost };
+                if (next_cost < witness_distance(arc.target)) {
+                    distance[arc.target] = next_cost;
+                    stamp[arc.target] = current_stamp;
+                    frontier.push({ next_cost, arc.target });
+                }
+            }
+        }
+    }
+
+    // The shortcuts needed to preserve every route passing through the node;
+    // a shortcut's cost includes crossing the junctions it skips
+    void shortcuts_for(uint32_t node, std::vector<Shortcut>& output)
+    {
+        output.clear();
+        const std::vector<Arc>& arcs { adjacency[node] };
+
+        for (size_t lhs = 0; lhs < arcs.size(); lhs++) {
+            if (contracted[arcs[lhs].target])
+                continue;
+
+            int limit { 0 };
+            for (size_t rhs = lhs + 1; rhs < arcs.size(); rhs++) {
+                if (!contracted[arcs[rhs].target])
+                    limit = std::max(limit, arcs[lhs].cost + Constants::JUNCTION_CROSSING_COST + arcs[rhs].cost);
+            }
+
+            if (limit == 0)
+                continue;
+
+            witness_search(arcs[lhs].target, node, limit);
+
+            for (size_t rhs = lhs + 1; rhs < arcs.size(); rhs++) {
+                if (contracted[arcs[rhs].target])
+                    continue;
+
+                int via_cost { arcs[lhs].cost + Constants::JUNCTION_CROSSING_COST + arcs[rhs].cost };
+                if (witness_distance(arcs[rhs].target) > via_cost)
+                    output.push_back({ arcs[lhs].target, arcs[rhs].target, via_cost });
+            }
+        }
+    }
+
+    int priority(uint32_t node, std::vector<Shortcut>& scratch)
+    {
+        shortcuts_for(node, scratch);
+        int degree {
+            static_cast<int>(std::count_if(
+                adjacency[node].begin(),
+                adjacency[node].end(),
+                [this](const Arc& arc) { return !contracted[arc.target]; }
+            ))
+        };
+        return static_cast<int>(scratch.size()) - degree + deleted_neighbours[node];
+    }
+
+public:
+    Contractor(Adjacency& adjacency)
+        : adjacency { adjacency }
+        , contracted(adjacency.size(), false)
+        , deleted_neighbours(adjacency.size(), 0)
+        , distance(adjacency.size(), UNREACHED)
+        , stamp(adjacency.size(), 0)
+    {
+    }
+
+    // Contract every node, cheapest first, returning the rank given to each
+    std::vector<uint32_t> contract()
+    {
+        std::vector<uint32_t> rank(adjacency.size(), 0);
+        std::vector<Shortcut> shortcuts;
+        MinQueue queue;
+
+        for (uint32_t node = 0; node < adjacency.size(); node++) {
+            queue.push({ priority(node, shortcuts), node });
+        }
+
+        uint32_t next_rank { 0 };
+        while (!queue.empty()) {
+            uint32_t node { queue.top().second };
+            queue.pop();
+
+            // Lazy update; the priority may have grown since the node was queued
+            int updated { priority(node, shortcuts) };
+            if (!queue.empty() && updated > queue.top().first) {
+                queue.push({ updated, node });
+                continue;
+            }
+
+            for (const Shortcut& shortcut : shortcuts) {
+                add_arc(adjacency[shortcut.from], shortcut.to, shortcut.cost, node);
+                add_arc(adjacency[shortcut.to], shortcut.from, shortcut.cost, node);
+            }
+
+            contracted[node] = true;
+            rank[node] = next_rank++;
+
+            for (const Arc& arc : adjacency[node]) {
+                deleted_neighbours[arc.target]++;
+            }
+        }
+
+        return rank;
+    }
+};
+
+const ContractionHierarchy::Edge& find_edge(
+    const ContractionHierarchy& hierarchy,
+    uint32_t lhs,
+    uint32_t rhs
+)
+{
+    uint32_t lower { hierarchy.rank[lhs] < hierarchy.rank[rhs] ? lhs : rhs };
+    uint32_t upper { lower == lhs ? rhs : lhs };
+
+    return *std::find_if(
+        hierarchy.edges.begin() + hierarchy.offsets[lower],
+        hierarchy.edges.begin() + hierarchy.offsets[lower + 1],
+        [upper](const ContractionHierarchy::Edge& edge) { return edge.target == upper; }
+    );
+}
+
+// Append the junctions after `from` up to and including `to`
+void unpack(
+    const ContractionHierarchy& hierarchy,
+    uint32_t from,
+    uint32_t to,
+    std::vector<entt::entity>& output
+)
+{
+    const ContractionHierarchy::Edge& edge { find_edge(hierarchy, from, to) };
+
+    if (edge.middle == NO_NODE) {
+        output.push_back(hierarchy.junctions[to]);
+        return;
+    }
+
+    unpack(hierarchy, from, edge.middle, output);
+    unpack(hierarchy, edge.middle, to, output);
+}
+
+void seed(SearchState& search, const std::vector<PathEndpoint>& endpoints)
+{
+    search.reset();
+    for (uint32_t index = 0; index < endpoints.size(); index++) {
+        const PathEndpoint& endpoint { endpoints[index] };
+        if (endpoint.cost >= search.cost_to(endpoint.node))
+            continue;
+
+        search.label(endpoint.node, endpoint.cost, NO_NODE, index);
+        search.push(endpoint.cost, endpoint.node);
+    }
+}
+
+// Settle the next junction, returning NO_NODE if it was a stale entry
+uint32_t settle(
+    const ContractionHierarchy& hierarchy,
+    SearchState& search,
+    const std::vector<PathEndpoint>& endpoints
+)
+{
+    auto [cost, node] { search.pop() };
+    if (cost > search.cost_to(node))
+        return NO_NODE;
+
+    const int crossing { Pathfinding::crossing_cost(search, endpoints, node) };
+    for (uint32_t index = hierarchy.offsets[node]; index < hierarchy.offsets[node + 1]; index++) {
+        const ContractionHierarchy::Edge& edge { hierarchy.edges[index] };
+        int next_cost { cost + crossing + edge.cost };
+
+        if (next_cost < search.cost_to(edge.target)) {
+            search.label(edge.target, next_cost, node, search.endpoint[node]);
+            search.push(next_cost, edge.target);
+        }
+    }
+
+    return node;
+}
+
+} // namespace
+
+namespace Hierarchy {
+
+void build(entt::registry& registry)
+{
+    const RoadGraph& graph { registry.ctx().get<const RoadGraph>() };
+
+    if (graph.junction_count() < Constants::HIERARCHY_MIN_JUNCTIONS) {
+        registry.ctx().erase<ContractionHierarchy>();
+        return;
+    }
+
+    ContractionHierarchy hierarchy {};
+
+    hierarchy.junctions = graph.junctions;
+    Adjacency adjacency(graph.junction_count());
+
+    for (uint32_t node = 0; node < graph.junction_count(); node++) {
+        for (uint32_t edge = graph.offsets[node]; edge < graph.offsets[node + 1]; edge++) {
+            add_arc(adjacency[node], graph.targets[edge], graph.costs[edge], NO_NODE);
+        }
+    }
+
+    hierarchy.rank = Contractor { adjacency }.contract();
+
+    // Keep only the edges leading upward, packed contiguously per junction
+    hierarchy.offsets.reserve(adjacency.size() + 1);
+    for (uint32_t node = 0; node < adjacency.size(); node++) {
+        hierarchy.offsets.push_back(hierarchy.edges.size());
+        for (const Arc& arc : adjacency[node]) {
+            if (hierarchy.rank[arc.target] > hierarchy.rank[node])
+                hierarchy.edges.push_back(arc);
+        }
+    }
+    hierarchy.offsets.push_back(hierarchy.edges.size());
+
+    registry.ctx().insert_or_assign(std::move(hierarchy));
+}
+
+bool query(
+    const ContractionHierarchy& hierarchy,
+    PathfindingContext& context,
+    JunctionRoute& route
+)
+{
+    SearchState& forward { context.forward };
+    SearchState& backward { context.backward };
+    seed(forward, context.sources);
+    seed(backward, context.targets);
+
+    int best { route.cost };
+    uint32_t meeting { NO_NODE };
+    context.searches++;
+
+    // Each search stops once it can no longer improve on the best meeting
+    while (std::min(forward.next_priority(), backward.next_priority()) < best) {
+        bool forward_turn { forward.next_priority() <= backward.next_priority() };
+        SearchState& search { forward_turn ? forward : backward };
+        const SearchState& other { forward_turn ? backward : forward };
+
+        uint32_t node { settle(hierarchy, search, forward_turn ? context.sources : context.targets) };
+        if (node == NO_NODE)
+            continue;
+
+        context.expanded++;
+        if (!other.reached(node))
+            continue;
+
+        // The meeting junction is crossed unless either side stands on it
+        int cost {
+            forward.cost_to(node) + backward.cost_to(node)
+            + std::min(
+                Pathfinding::crossing_cost(forward, context.sources, node),
+                Pathfinding::crossing_cost(backward, context.targets, node)
+            )
+        };
+        if (cost < best) {
+            best = cost;
+            meeting = node;
+        }
+    }
+
+    if (meeting == NO_NODE)
+        return false;
+
+    // Walk both searches back from the meeting junction to their seeds
+    std::vector<uint32_t>& chain { context.chain };
+    chain.clear();
+    for (uint32_t node = meeting; node != NO_NODE; node = forward.parent[node]) {
+        chain.push_back(node);
+    }
+
+    route.junctions.clear();
+    route.junctions.push_back(hierarchy.junctions[chain.back()]);
+    for (size_t index = chain.size() - 1; index > 0; index--) {
+        unpack(hierarchy, chain[index], chain[index - 1], route.junctions);
+    }
+
+    uint32_t source_node { chain.back() };
+    uint32_t target_node { meeting };
+    for (uint32_t node = meeting; backward.parent[node] != NO_NODE; node = backward.parent[node]) {
+        unpack(hierarchy, node, backward.parent[node], route.junctions);
+        target_node = backward.parent[node];
+    }
+
+    route.source_tile = context.sources[forward.endpoint[source_node]].tile;
+    route.target_tile = context.targets[backward.endpoint[target_node]].tile;
+    route.cost = best;
+    return true;
+}
+
+} // namespace
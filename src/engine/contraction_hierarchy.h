@@ -0,0 +1,58 @@
+#ifndef CONTRACTIONHIERARCHY_H
+#define CONTRACTIONHIERARCHY_H
+
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <pathfinding.h>
+#include <pathfinding_context.h>
+#include <vector>
+
+/*
+    Shortcut index over the junction graph.
+
+    Junctions are contracted one at a time (cheapest first); whenever removing
+    a junction would lengthen the shortest route between two of its remaining
+    neighbours, a shortcut edge carrying the same cost is added between them.
+    Every junction is given the rank at which it was contracted and only the
+    edges leading to higher ranked junctions are kept, so a query is two small
+    upward searches - one from either end - that meet at the highest ranked
+    junction of the route.
+
+    Shortcuts remember the junction they bypass, so a route found in the index
+    unpacks into the same junction sequence a search of the full graph gives.
+*/
+
+struct ContractionHierarchy {
+    static constexpr uint32_t NO_NODE { UINT32_MAX };
+
+    struct Edge {
+        uint32_t target;
+        int cost;
+        // The contracted junction a shortcut bypasses; NO_NODE for a segment
+        uint32_t middle;
+    };
+
+    // Indexed by JunctionComponent::index
+    std::vector<entt::entity> junctions;
+    std::vector<uint32_t> rank;
+
+    // Upward edges of junction n are edges[offsets[n]] to edges[offsets[n + 1]]
+    std::vector<uint32_t> offsets;
+    std::vector<Edge> edges;
+};
+
+namespace Hierarchy {
+
+void build(entt::registry& registry);
+
+// Replaces the route if the index finds a cheaper one between the context's
+// sources and targets
+bool query(
+    const ContractionHierarchy& hierarchy,
+    PathfindingContext& context,
+    JunctionRoute& route
+);
+
+} // namespace
+
+#endif
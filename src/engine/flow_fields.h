@@ -0,0 +1,23 @@
+#ifndef FLOWFIELDS_H
+#define FLOWFIELDS_H
+
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <pathfinding_context.h>
+#include <unordered_map>
+
+/*
+    Flow fields towards receivers with several senders waiting on them. Each
+    is a search grown back from the receiver's road access to every junction,
+    so a sender reads its path off the field instead of searching. Dropped
+    whenever the graph is rebuilt.
+*/
+struct FlowFields {
+    bool enabled { true };
+    uint64_t generation { 0 };
+    // Keyed by the receiving building
+    std::unordered_map<entt::entity, ReverseSearch> fields;
+    std::unordered_map<entt::entity, int> waiting;
+};
+
+#endif
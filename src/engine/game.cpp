@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <archive.h>
 #include <backends/imgui_impl_sdl2.h>
 #include <backends/imgui_impl_sdlrenderer2.h>
@@ -5,6 +6,7 @@
 #include <components/camera_component.h>
 #include <components/connectivity_component.h>
 #include <components/flags.h>
+#include <components/graph_state_component.h>
 #include <components/junction_component.h>
 #include <components/mouse_component.h>
 #include <components/segment_component.h>
@@ -17,10 +19,14 @@
 #include <entt/entt.hpp>
 #include <game.h>
 #include <grid.h>
+#include <grid_pathfinding.h>
 #include <imgui.h>
 #include <iso_utility.h>
 #include <memory>
+#include <path_cache.h>
 #include <projection.h>
+#include <route_store.h>
+#include <segment_arena.h>
 #include <spdlog/spdlog.h>
 #include <sprite.h>
 #include <spritesheet.h>
@@ -34,53 +40,88 @@
 #include <systems/render_system.h>
 #include <systems/spatialmap_system.h>
 #include <systems/walker_system.h>
+#include <thread>
+#include <type_traits>
+#include <worker_pool.h>
 
 namespace {
+// Write the game with either archive, OutputArchive or BinaryOutputArchive
+template <typename Archive>
 void save_to(entt::registry& registry, const std::string output_path)
 {
-    for (auto entity : registry.view<SegmentComponent>())
-        registry.destroy(entity);
-
-    registry.clear<ConnectivityComponent>();
-    registry.clear<JunctionComponent>();
-    registry.clear<SegmentMemberComponent>();
+    // Segments replaced by the latest rebuild are only released next frame
+    EntityReleaseSystem::update(registry);
 
-    OutputArchive my_archive;
+    Archive my_archive;
     entt::basic_snapshot(registry)
         .get<entt::entity>(my_archive)
         .get<GridPositionComponent>(my_archive)
         .get<TransformComponent>(my_archive)
         .get<SpriteComponent>(my_archive)
         .get<SpatialMapCellSpanComponent>(my_archive)
-        .get<BuildingPairComponent>(my_archive);
+        .get<BuildingPairComponent>(my_archive)
+        .get<JunctionComponent>(my_archive)
+        .get<SegmentComponent>(my_archive);
 
     my_archive.save_context_element("tilemap", registry.ctx().get<Grid<entt::entity, TileMapProjection>>());
     my_archive.save_context_element("spatialmap", registry.ctx().get<Grid<entt::entity, SpatialMapProjection>>());
+    my_archive.save_context_element("segment_arena", registry.ctx().emplace<SegmentArena>());
+    my_archive.save_context_element("road_graph_checksum", GraphSystem::checksum(registry));
     my_archive.to_file(output_path);
 }
 
-void load_from(entt::registry& registry, const std::string input_path)
+// Returns false, having loaded no entities, if the binary archive turns out
+// to be corrupt
+template <typename Archive>
+bool load_from(entt::registry& registry, Archive& my_archive)
 {
-    InputArchive my_archive(input_path, registry.ctx().get<const SpriteSheet>());
-
     my_archive.load_context_element("tilemap", registry.ctx().get<Grid<entt::entity, TileMapProjection>>());
     my_archive.load_context_element("spatialmap", registry.ctx().get<Grid<entt::entity, SpatialMapProjection>>());
 
-    entt::snapshot_loader { registry }
+    // Saves from before the road graph was kept have to rebuild it
+    const bool saved_graph { my_archive.has_context_element("road_graph_checksum") };
+
+    // Segments take up their members from the arena as they're loaded
+    if (saved_graph)
+        my_archive.load_context_element("segment_arena", registry.ctx().emplace<SegmentArena>());
+
+    // Binary context elements are only checked as they're read
+    if constexpr (std::is_same_v<Archive, BinaryInputArchive>) {
+        if (!my_archive.valid())
+            return false;
+    }
+
+    entt::snapshot_loader loader { registry };
+    loader
         .get<entt::entity>(my_archive)
         .get<GridPositionComponent>(my_archive)
         .get<TransformComponent>(my_archive)
         .get<SpriteComponent>(my_archive)
         .get<SpatialMapCellSpanComponent>(my_archive)
-        .get<BuildingPairComponent>(my_archive)
-        .orphans();
+        .get<BuildingPairComponent>(my_archive);
+
+    if (saved_graph) {
+        loader
+            .get<JunctionComponent>(my_archive)
+            .get<SegmentComponent>(my_archive);
+    }
+
+    loader.orphans();
 
     // // TODO: ConnectivityUpdateFlag potentially not created on load
     for (auto [entity, sprite] : registry.view<SpriteComponent>().each()) {
         registry.emplace_or_replace<ConnectivityComponent>(entity, sprite.sprite_definition->directions);
     }
 
-    GraphSystem::update(registry);
+    if (saved_graph) {
+        uint64_t checksum { 0 };
+        my_archive.load_context_element("road_graph_checksum", checksum);
+        GraphSystem::restore(registry, checksum);
+    } else {
+        GraphSystem::update(registry);
+    }
+
+    return true;
 }
 }
 
@@ -143,6 +184,10 @@ void Game::initialise()
     registry.on_construct<TransformComponent>().connect<&flag<SpatialMapEntityCreateFlag>>();
     registry.on_update<TransformComponent>().connect<&flag<SpatialMapEntityUpdateFlag>>();
 
+    // Walkers patch their sprites as they turn; only tiles matter here
+    registry.on_construct<SpriteComponent>().connect<&flag_tile<PassabilityUpdateFlag>>();
+    registry.on_update<SpriteComponent>().connect<&flag_tile<PassabilityUpdateFlag>>();
+
     registry.on_construct<SegmentComponent>().connect<&SpatialMapSystem::create_segment>();
     registry.on_construct<SegmentComponent>().connect<&GraphSystem::create>();
 
@@ -150,7 +195,26 @@ void Game::initialise()
     registry.on_update<ConnectivityComponent>().connect<&flag<ConnectivityUpdateFlag>>();
     registry.on_destroy<ConnectivityComponent>().connect<&flag<ConnectivityUpdateFlag>>();
 
-    load_from(registry, Constants::SAVE_FILE_PATH);
+    // Needs to happen before load; loading builds the road graph
+    registry.ctx().emplace<GraphStateComponent>();
+    registry.ctx().emplace<PassabilityMap>();
+    registry.ctx().emplace<PathCache>(Constants::PATH_CACHE_CAPACITY);
+    registry.ctx().emplace<RouteStore>();
+    // The calling thread works alongside the pool
+    registry.ctx().emplace<WorkerPool>(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+    // The binary save when there is a readable one, otherwise the JSON
+    const SpriteSheet& spritesheet { registry.ctx().get<const SpriteSheet>() };
+    BinaryInputArchive binary_archive { Constants::BINARY_SAVE_FILE_PATH, spritesheet };
+    if (!binary_archive.valid() || !load_from(registry, binary_archive)) {
+        if (Constants::STREAM_JSON_SAVE) {
+            StreamingInputArchive json_archive { Constants::SAVE_FILE_PATH, spritesheet };
+            load_from(registry, json_archive);
+        } else {
+            InputArchive json_archive { Constants::SAVE_FILE_PATH, spritesheet };
+            load_from(registry, json_archive);
+        }
+    }
 
     registry.ctx().emplace<MouseComponent>();
 
@@ -200,6 +264,7 @@ void Game::update([[maybe_unused]] const float delta_time)
     CameraSystem::update(registry);
     BuildingSystem::update(registry);
     GraphSystem::update(registry);
+    WalkerSystem::repair(registry);
     SpatialMapSystem::update(registry);
     MouseSystem::update(registry);
     RenderSystem::update(registry, debug_mode);
@@ -252,7 +317,9 @@ void Game::run()
 
 void Game::destroy()
 {
-    save_to(registry, Constants::SAVE_FILE_PATH);
+    save_to<BinaryOutputArchive>(registry, Constants::BINARY_SAVE_FILE_PATH);
+    if (Constants::EXPORT_JSON_SAVE)
+        save_to<OutputArchive>(registry, Constants::SAVE_FILE_PATH);
     ImGui_ImplSDLRenderer2_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
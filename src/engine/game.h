@@ -2,6 +2,7 @@
 #define GAME_H
 
 #include <SDL2/SDL.h>
+#include <components/grid_position_component.h>
 #include <entt/entt.hpp>
 #include <iso_utility.h>
 #include <memory>
@@ -12,6 +13,14 @@ void flag(entt::registry& registry, entt::entity entity)
     registry.emplace_or_replace<Flag>(entity);
 }
 
+// As flag, but only for the tiles of the tilemap
+template <typename Flag>
+void flag_tile(entt::registry& registry, entt::entity entity)
+{
+    if (registry.all_of<GridPositionComponent>(entity))
+        registry.emplace_or_replace<Flag>(entity);
+}
+
 class Game {
     bool is_running { false };
     bool debug_mode { false };
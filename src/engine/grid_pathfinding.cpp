@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <components/path_component.h>
+#include <components/transform_component.h>
+#include <constants.h>
+#include <directions.h>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <grid.h>
+#include <grid_pathfinding.h>
+#include <pathfinding.h>
+#include <pathfinding_context.h>
+#include <projection.h>
+#include <systems/passability_system.h>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t NO_NODE { SearchState::NO_NODE };
+
+// Exact cost of an unobstructed 8-way walk, so never an overestimate
+int octile_distance(glm::ivec2 from, glm::ivec2 to)
+{
+    glm::ivec2 delta { glm::abs(to - from) };
+    int diagonal { std::min(delta.x, delta.y) };
+    int straight { std::max(delta.x, delta.y) - diagonal };
+    return diagonal * GridPathfinding::DIAGONAL_COST + straight * GridPathfinding::STRAIGHT_COST;
+}
+
+// The single step taken along a straight or diagonal run
+glm::ivec2 step_between(glm::ivec2 from, glm::ivec2 to)
+{
+    glm::ivec2 delta { to - from };
+    return { (delta.x > 0) - (delta.x < 0), (delta.y > 0) - (delta.y < 0) };
+}
+
+class JumpSearch {
+    const PassabilityMap& passability;
+    glm::ivec2 goal;
+
+    bool open(int x, int y) const { return passability.passable({ x, y }); }
+
+    // Walk on from the position in the step direction until reaching the
+    // goal, a tile where the route may have to turn, or an obstruction
+    bool jump(glm::ivec2 position, glm::ivec2 step, glm::ivec2& jump_point) const
+    {
+        const int dx { step.x };
+        const int dy { step.y };
+
+        while (passability.passable(position)) {
+            const int x { position.x };
+            const int y { position.y };
+
+            if (position == goal) {
+                jump_point = position;
+                return true;
+            }
+
+            if (dx != 0 && dy != 0) {
+                // A diagonal run stops wherever one of its straight runs finds something
+                glm::ivec2 ignored;
+                if (jump({ x + dx, y }, { dx, 0 }, ignored) || jump({ x, y + dy }, { 0, dy }, ignored)) {
+                    jump_point = position;
+                    return true;
+                }
+
+                if (!open(x + dx, y) || !open(x, y + dy))
+                    return false;
+            } else if (dx != 0) {
+                // Forced neighbours: tiles beside the run that the previous
+                // tile couldn't reach diagonally
+                if ((open(x, y - 1) && !open(x - dx, y - 1)) || (open(x, y + 1) && !open(x - dx, y + 1))) {
+                    jump_point = position;
+                    return true;
+                }
+            } else {
+                if ((open(x - 1, y) && !open(x - 1, y - dy)) || (open(x + 1, y) && !open(x + 1, y - dy))) {
+                    jump_point = position;
+                    return true;
+                }
+            }
+
+            position += step;
+        }
+
+        return false;
+    }
+
+    // The directions worth searching from a jump point, given the direction
+    // it was reached in; every direction from the start. Other tiles are
+    // reached at least as cheaply without passing through this one, so only
+    // the natural neighbours and those forced by an obstruction are kept
+    int directions(glm::ivec2 position, glm::ivec2 step, glm::ivec2 (&output)[8]) const
+    {
+        const int x { position.x };
+        const int y { position.y };
+        int count { 0 };
+
+        if (step == glm::ivec2 { 0, 0 }) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    if (dx == 0 && dy == 0)
+                        continue;
+                    if (dx != 0 && dy != 0 && (!open(x + dx, y) || !open(x, y + dy)))
+                        continue;
+                    output[count++] = { dx, dy };
+                }
+            }
+            return count;
+        }
+
+        const int dx { step.x };
+        const int dy { step.y };
+
+        if (dx != 0 && dy != 0) {
+            output[count++] = { 0, dy };
+            output[count++] = { dx, 0 };
+            if (open(x, y + dy) && open(x + dx, y))
+                output[count++] = { dx, dy };
+        } else if (dx != 0) {
+            // Forced: beside the run, and not reachable diagonally from behind
+            bool ahead { open(x + dx, y) };
+            if (ahead)
+                output[count++] = { dx, 0 };
+            for (int side : { -1, 1 }) {
+                if (!open(x, y + side) || open(x - dx, y + side))
+                    continue;
+                output[count++] = { 0, side };
+                if (ahead)
+                    output[count++] = { dx, side };
+            }
+        } else {
+            bool ahead { open(x, y + dy) };
+            if (ahead)
+                output[count++] = { 0, dy };
+            for (int side : { -1, 1 }) {
+                if (!open(x + side, y) || open(x + side, y - dy))
+                    continue;
+                output[count++] = { side, 0 };
+                if (ahead)
+                    output[count++] = { side, dy };
+            }
+        }
+
+        return count;
+    }
+
+public:
+    JumpSearch(const PassabilityMap& passability, glm::ivec2 goal)
+        : passability { passability }
+        , goal { goal }
+    {
+    }
+
+    glm::ivec2 position_of(uint32_t node) const
+    {
+        return { int(node) % passability.dimensions.x, int(node) / passability.dimensions.x };
+    }
+
+    uint32_t node_of(glm::ivec2 position) const
+    {
+        return uint32_t(passability.index(position));
+    }
+
+    // Settle the node, labelling and queueing the jump points it leads to
+    void expand(SearchState& search, uint32_t node) const
+    {
+        glm::ivec2 position { position_of(node) };
+        glm::ivec2 step { 0, 0 };
+        if (search.parent[node] != NO_NODE)
+            step = step_between(position_of(search.parent[node]), position);
+
+        glm::ivec2 candidates[8];
+        int count { directions(position, step, candidates) };
+
+        for (int index = 0; index < count; index++) {
+            glm::ivec2 jump_point;
+            if (!jump(position + candidates[index], candidates[index], jump_point))
+                continue;
+
+            uint32_t next { node_of(jump_point) };
+            int next_cost { search.cost[node] + octile_distance(position, jump_point) };
+            if (next_cost < search.cost_to(next)) {
+                search.label(next, next_cost, node, 0);
+                search.push(next_cost + octile_distance(jump_point, goal), next);
+            }
+        }
+    }
+};
+
+} // namespace
+
+namespace GridPathfinding {
+
+int path_between(
+    const PassabilityMap& passability,
+    SearchState& search,
+    glm::ivec2 from,
+    glm::ivec2 to,
+    std::vector<glm::ivec2>& path
+)
+{
+    path.clear();
+
+    if (!passability.passable(from) || !passability.passable(to))
+        return Pathfinding::NO_ROUTE;
+
+    size_t tile_count { size_t(passability.dimensions.x) * passability.dimensions.y };
+    if (search.cost.size() != tile_count)
+        search.resize(tile_count);
+
+    JumpSearch jump_search { passability, to };
+    uint32_t start { jump_search.node_of(from) };
+    uint32_t goal { jump_search.node_of(to) };
+
+    search.reset();
+    search.label(start, 0, NO_NODE, 0);
+    search.push(octile_distance(from, to), start);
+
+    while (!search.empty()) {
+        auto [priority, node] { search.pop() };
+        if (priority - octile_distance(jump_search.position_of(node), to) > search.cost_to(node))
+            continue;
+
+        if (node == goal)
+            break;
+
+        jump_search.expand(search, node);
+    }
+
+    if (!search.reached(goal))
+        return Pathfinding::NO_ROUTE;
+
+    for (uint32_t node = goal; node != NO_NODE; node = search.parent[node]) {
+        path.push_back(jump_search.position_of(node));
+    }
+    std::reverse(path.begin(), path.end());
+
+    return search.cost_to(goal);
+}
+
+int path_between(
+    entt::registry& registry,
+    glm::ivec2 from,
+    glm::ivec2 to,
+    std::vector<glm::ivec2>& path
+)
+{
+    if (!registry.ctx().contains<GridPathfindingContext>())
+        registry.ctx().emplace<GridPathfindingContext>();
+
+    // Tiles changed since the last search are only applied when needed
+    PassabilitySystem::update(registry);
+
+    return path_between(
+        registry.ctx().get<const PassabilityMap>(),
+        registry.ctx().get<GridPathfindingContext>().search,
+        from,
+        to,
+        path
+    );
+}
+
+void expand_path(
+    const entt::registry& registry,
+    const std::vector<glm::ivec2>& path,
+    std::vector<PathSegment>& expanded_path
+)
+{
+    const Grid<entt::entity, TileMapProjection>& tilemap {
+        registry.ctx().get<const Grid<entt::entity, TileMapProjection>>()
+    };
+
+    for (size_t index = 0; index + 1 < path.size(); index++) {
+        glm::ivec2 start { registry.get<const TransformComponent>(tilemap[path[index]]).position };
+        glm::ivec2 end { registry.get<const TransformComponent>(tilemap[path[index + 1]]).position };
+
+        expanded_path.emplace_back(
+            start + Constants::TILE_CENTRE,
+            end + Constants::TILE_CENTRE,
+            Direction::from_vector(path[index + 1] - path[index])
+        );
+    }
+}
+
+} // namespace
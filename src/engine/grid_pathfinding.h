@@ -0,0 +1,106 @@
+#ifndef GRIDPATHFINDING_H
+#define GRIDPATHFINDING_H
+
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <pathfinding_context.h>
+#include <vector>
+
+struct PathSegment;
+
+/*
+    One bit per tile of the tilemap, set where walkers can cross the tile
+    off-road. Brought up to date by PassabilitySystem from the tile sprites
+    whenever it's searched.
+*/
+struct PassabilityMap {
+    glm::ivec2 dimensions {};
+    std::vector<uint64_t> bits;
+
+    void resize(glm::ivec2 map_dimensions)
+    {
+        dimensions = map_dimensions;
+        bits.assign((size_t(dimensions.x) * dimensions.y + 63) / 64, 0);
+    }
+
+    int index(glm::ivec2 position) const
+    {
+        return (position.y * dimensions.x) + position.x;
+    }
+
+    // Tiles off the map are never passable
+    bool passable(glm::ivec2 position) const
+    {
+        if (position.x < 0 || position.y < 0 || position.x >= dimensions.x || position.y >= dimensions.y)
+            return false;
+
+        int bit { index(position) };
+        return (bits[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    void set(glm::ivec2 position, bool passable)
+    {
+        int bit { index(position) };
+        if (passable)
+            bits[bit / 64] |= uint64_t { 1 } << (bit % 64);
+        else
+            bits[bit / 64] &= ~(uint64_t { 1 } << (bit % 64));
+    }
+};
+
+/*
+    Scratch search state for off-road queries against the registry, kept in
+    the context apart from the road graph's.
+*/
+struct GridPathfindingContext {
+    SearchState search;
+};
+
+/*
+    Jump point search over the tilemap, for movement that ignores the roads.
+
+    Moves are 8-way, but a diagonal step is only taken where both of the
+    tiles beside it are passable, so paths never clip the corner of water.
+    Straight and diagonal runs across open ground are skipped in one jump;
+    only tiles where the best route might turn are ever put on the frontier,
+    so the search touches a small fraction of the tiles an A* would.
+
+    Search state is indexed by tile and reused between queries, as for the
+    road graph; see SearchState.
+*/
+namespace GridPathfinding {
+
+// Grid steps cost 10 straight and 14 diagonally
+inline constexpr int STRAIGHT_COST { 10 };
+inline constexpr int DIAGONAL_COST { 14 };
+
+// The turning points of the cheapest path, both ends included; returns the
+// cost of the path, or Pathfinding::NO_ROUTE leaving the path empty
+int path_between(
+    const PassabilityMap& passability,
+    SearchState& search,
+    glm::ivec2 from,
+    glm::ivec2 to,
+    std::vector<glm::ivec2>& path
+);
+
+// As above, using the registry's passability map, brought up to date with
+// the tiles, and scratch search state
+int path_between(
+    entt::registry& registry,
+    glm::ivec2 from,
+    glm::ivec2 to,
+    std::vector<glm::ivec2>& path
+);
+
+// One segment per straight or diagonal run, from tile centre to tile centre
+void expand_path(
+    const entt::registry& registry,
+    const std::vector<glm::ivec2>& path,
+    std::vector<PathSegment>& expanded_path
+);
+
+} // namespace
+
+#endif
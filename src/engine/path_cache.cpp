@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <entt/entt.hpp>
+#include <limits>
+#include <path_cache.h>
+#include <vector>
+
+namespace {
+uint64_t cache_key(entt::entity origin, entt::entity target)
+{
+    return (uint64_t { entt::to_integral(origin) } << 32) | entt::to_integral(target);
+}
+}
+
+PathCache::PathCache(size_t capacity)
+    : capacity { capacity }
+{
+    index.reserve(capacity);
+}
+
+PathCache::Entry* PathCache::find(entt::entity origin, entt::entity target, uint64_t generation)
+{
+    auto it { index.find(cache_key(origin, target)) };
+    if (it == index.end())
+        return nullptr;
+
+    // Found on a graph that has since been rebuilt
+    if (it->second->generation != generation) {
+        entries.erase(it->second);
+        index.erase(it);
+        return nullptr;
+    }
+
+    entries.splice(entries.begin(), entries, it->second);
+    return &entries.front();
+}
+
+void PathCache::insert(
+    entt::entity origin,
+    entt::entity target,
+    uint64_t generation,
+    int cost,
+    const Route& route
+)
+{
+    uint64_t key { cache_key(origin, target) };
+
+    if (auto it { index.find(key) }; it != index.end()) {
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    if (entries.size() == capacity) {
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+
+    entries.push_front({ key, generation, cost, route });
+    index.emplace(key, entries.begin());
+}
+
+Route PathCache::lookup(
+    const std::vector<entt::entity>& origins,
+    entt::entity target,
+    uint64_t generation
+)
+{
+    const Entry* best { nullptr };
+    int lowest_bound { std::numeric_limits<int>::max() };
+
+    for (entt::entity origin : origins) {
+        const Entry* entry { find(origin, target, generation) };
+
+        if (!entry) {
+            misses++;
+            return nullptr;
+        }
+
+        if (!entry->route)
+            lowest_bound = std::min(lowest_bound, entry->cost);
+        else if (!best || entry->cost < best->cost)
+            best = entry;
+    }
+
+    if (!best || best->cost > lowest_bound) {
+        misses++;
+        return nullptr;
+    }
+
+    hits++;
+    return best->route;
+}
+
+void PathCache::store(
+    const std::vector<entt::entity>& origins,
+    entt::entity chosen_origin,
+    entt::entity target,
+    uint64_t generation,
+    int cost,
+    const Route& route
+)
+{
+    for (entt::entity origin : origins) {
+        if (origin == chosen_origin)
+            continue;
+
+        // A path already known from this origin says more than a bound
+        if (!find(origin, target, generation))
+            insert(origin, target, generation, cost, nullptr);
+    }
+
+    insert(chosen_origin, target, generation, cost, route);
+}
+
+float PathCache::hit_rate() const
+{
+    uint64_t lookups { hits + misses };
+    return lookups == 0 ? 0.f : static_cast<float>(hits) / lookups;
+}
@@ -0,0 +1,61 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <list>
+#include <route_store.h>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Least-recently-used store of routes, keyed by (access point, target tile)
+    and stamped with the graph generation they were found on. Entries from an
+    older generation are dropped when next looked up.
+
+    A multi-source query only proves which access point won; the others are
+    stored as bounds (a cost with no path) since their own best route can be no
+    cheaper. A sender is served from the cache once every one of its access
+    points has an entry and the cheapest path is within all of the bounds.
+*/
+class PathCache {
+    struct Entry {
+        uint64_t key;
+        uint64_t generation;
+        int cost;
+        // Null for a bound
+        Route route;
+    };
+
+    size_t capacity;
+    std::list<Entry> entries;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+
+    Entry* find(entt::entity origin, entt::entity target, uint64_t generation);
+    void insert(entt::entity origin, entt::entity target, uint64_t generation, int cost, const Route& route);
+
+public:
+    uint64_t hits { 0 };
+    uint64_t misses { 0 };
+
+    PathCache(size_t capacity);
+
+    Route lookup(
+        const std::vector<entt::entity>& origins,
+        entt::entity target,
+        uint64_t generation
+    );
+
+    void store(
+        const std::vector<entt::entity>& origins,
+        entt::entity chosen_origin,
+        entt::entity target,
+        uint64_t generation,
+        int cost,
+        const Route& route
+    );
+
+    float hit_rate() const;
+};
+
+#endif
@@ -6,224 +6,800 @@
 #include <components/segment_member_component.h>
 #include <components/spatialmapcell_component.h>
 #include <components/transform_component.h>
+#include <constants.h>
+#include <contraction_hierarchy.h>
 #include <entt/entt.hpp>
 #include <glm/glm.hpp>
 #include <grid.h>
+#include <limits>
 #include <optional>
 #include <pathfinding.h>
+#include <pathfinding_context.h>
 #include <projection.h>
-#include <queue>
-#include <unordered_map>
+#include <road_graph.h>
 #include <vector>
 
 namespace {
 
-bool is_adjacent_to(glm::vec2 from, glm::vec2 to)
+constexpr uint32_t NO_NODE { SearchState::NO_NODE };
+constexpr int UNREACHED { std::numeric_limits<int>::max() };
+
+// Goals sit next to the target tile, so the distance to the target less one
+// never overestimates the remaining cost
+int heuristic(const glm::ivec2& lhs, const glm::ivec2& rhs)
 {
-    glm::vec2 diff = glm::abs(from - to);
-    return diff.x + diff.y == 1;
+    glm::ivec2 delta { glm::abs(rhs - lhs) };
+    return std::max(delta.x + delta.y - 1, 0);
 }
 
-bool is_goal(const entt::registry& registry, entt::entity goal, entt::entity comparator)
+// Segments run straight from their origin, so a member's place along one
+// is its distance from the origin
+int member_position(const entt::registry& registry, const SegmentComponent& segment, entt::entity tile)
 {
-    return (
-        goal == comparator
-        || is_adjacent_to(
-            registry.get<const GridPositionComponent>(goal).position,
-            registry.get<const GridPositionComponent>(comparator).position
-        )
-    );
+    glm::ivec2 delta {
+        registry.get<const GridPositionComponent>(tile).position
+        - registry.get<const GridPositionComponent>(segment.origin).position
+    };
+    return std::abs(delta.x) + std::abs(delta.y) - 1;
 }
 
-struct PathStep {
-    entt::entity tile;
-    int priority;
-};
+// The cost of routes that never need to reach a junction; either the source is
+// already a goal, or both lie on the same segment
+int direct_cost(const entt::registry& registry, entt::entity from_tile, entt::entity goal_tile)
+{
+    if (from_tile == goal_tile)
+        return 0;
+
+    const SegmentMemberComponent* from_member { registry.try_get<const SegmentMemberComponent>(from_tile) };
+    const SegmentMemberComponent* goal_member { registry.try_get<const SegmentMemberComponent>(goal_tile) };
+
+    if (!from_member || !goal_member || from_member->segment != goal_member->segment)
+        return UNREACHED;
+
+    const SegmentComponent& segment { registry.get<const SegmentComponent>(from_member->segment) };
+    return std::abs(member_position(registry, segment, from_tile) - member_position(registry, segment, goal_tile));
+}
 
-struct Compare {
-    bool operator()(const PathStep& lhs, const PathStep& rhs)
-    {
-        return lhs.priority > rhs.priority;
+// Offer the routes that never need to reach a junction, from any source tile
+// other than the target itself
+void offer_direct(
+    const entt::registry& registry,
+    const entt::entity* from_begin,
+    const entt::entity* from_end,
+    entt::entity to_tile,
+    const std::vector<PathEndpoint>& targets,
+    JunctionRoute& route
+)
+{
+    for (const entt::entity* from_tile = from_begin; from_tile != from_end; from_tile++) {
+        if (*from_tile == to_tile)
+            continue;
+
+        for (const PathEndpoint& target : targets) {
+            int cost { direct_cost(registry, *from_tile, target.tile) };
+            if (cost < route.cost) {
+                route.source_tile = *from_tile;
+                route.target_tile = target.tile;
+                route.cost = cost;
+            }
+        }
     }
-};
+}
 
-int heuristic(const glm::vec2& lhs, const glm::vec2& rhs)
+// The cost of reaching any target through the node can be no less than its
+// difference in distance from a landmark; UNREACHED when the landmarks show
+// no target is connected to the node at all
+int landmark_bound(const PathfindingContext& context, uint32_t node)
 {
-    glm::vec2 delta { glm::abs(rhs - lhs) };
-    return delta.x + delta.y;
+    const size_t landmark_count { context.landmark_count };
+    const int* node_distances { &context.landmark_distances[node * landmark_count] };
+    int bound { UNREACHED };
+
+    for (const PathEndpoint& target : context.targets) {
+        const int* target_distances { &context.landmark_distances[target.node * landmark_count] };
+        int lower { 0 };
+        bool connected { true };
+
+        for (size_t landmark = 0; landmark < landmark_count && connected; landmark++) {
+            int from_landmark { node_distances[landmark] };
+            int to_landmark { target_distances[landmark] };
+
+            connected = (from_landmark == UNREACHED) == (to_landmark == UNREACHED);
+            if (connected && from_landmark != UNREACHED)
+                lower = std::max(lower, std::abs(from_landmark - to_landmark));
+        }
+
+        if (connected)
+            bound = std::min(bound, lower + target.cost);
+    }
+
+    return bound;
 }
 
-void advance(
-    const entt::registry& registry,
-    std::priority_queue<PathStep, std::vector<PathStep>, Compare>& frontier,
-    std::unordered_map<entt::entity, entt::entity>& came_from,
-    entt::entity current_tile,
-    entt::entity query_tile,
-    entt::entity target_tile
+// Computed once per junction per search, as the landmark bound isn't free
+int estimate(PathfindingContext& context, uint32_t node, const glm::ivec2& target_position)
+{
+    int bound { heuristic(context.positions[node], target_position) };
+    if (context.use_landmarks && context.landmark_count > 0)
+        bound = std::max(bound, landmark_bound(context, node));
+
+    context.estimates[node] = bound;
+    return bound;
+}
+
+/*
+    A* over the dense junction graph. The targets are folded in as exit costs
+    held in the backward state, so reaching any junction with an exit offers a
+    finished route; the search stops once nothing left in the frontier can
+    beat the best route offered so far.
+*/
+void search_route(
+    PathfindingContext& context,
+    const glm::ivec2& target_position,
+    JunctionRoute& route
 )
 {
-    if (came_from.find(query_tile) != came_from.end())
+    SearchState& frontier { context.forward };
+    SearchState& exits { context.backward };
+    frontier.reset();
+    exits.reset();
+    context.searches++;
+
+    for (uint32_t index = 0; index < context.targets.size(); index++) {
+        const PathEndpoint& target { context.targets[index] };
+        if (target.cost < exits.cost_to(target.node))
+            exits.label(target.node, target.cost, NO_NODE, index);
+    }
+
+    for (uint32_t index = 0; index < context.sources.size(); index++) {
+        const PathEndpoint& source { context.sources[index] };
+        if (source.cost >= frontier.cost_to(source.node))
+            continue;
+
+        int bound { frontier.reached(source.node) ? context.estimates[source.node] : estimate(context, source.node, target_position) };
+        if (bound == UNREACHED)
+            continue;
+
+        frontier.label(source.node, source.cost, NO_NODE, index);
+        frontier.push(source.cost + bound, source.node);
+    }
+
+    int best { route.cost };
+    uint32_t best_node { NO_NODE };
+
+    while (!frontier.empty() && frontier.next_priority() < best) {
+        auto [priority, node] { frontier.pop() };
+        int cost { frontier.cost_to(node) };
+
+        // Stale entry; the junction has since been reached more cheaply
+        if (priority > cost + context.estimates[node])
+            continue;
+
+        context.expanded++;
+        const int crossing { Pathfinding::crossing_cost(frontier, context.sources, node) };
+        if (exits.reached(node)) {
+            int exit_cost {
+                cost + exits.cost_to(node)
+                + std::min(crossing, Pathfinding::crossing_cost(exits, context.targets, node))
+            };
+            if (exit_cost < best) {
+                best = exit_cost;
+                best_node = node;
+            }
+        }
+
+        for (const PathfindingContext::Link& link : context.links[node]) {
+            if (link.node == NO_NODE)
+                continue;
+
+            int next_cost { cost + crossing + link.cost };
+            if (next_cost >= frontier.cost_to(link.node))
+                continue;
+
+            int bound { frontier.reached(link.node) ? context.estimates[link.node] : estimate(context, link.node, target_position) };
+            if (bound == UNREACHED)
+                continue;
+
+            frontier.label(link.node, next_cost, node, frontier.endpoint[node]);
+            frontier.push(next_cost + bound, link.node);
+        }
+    }
+
+    if (best_node == NO_NODE)
+        return;
+
+    context.chain.clear();
+    for (uint32_t node = best_node; node != NO_NODE; node = frontier.parent[node]) {
+        context.chain.push_back(node);
+    }
+
+    route.junctions.clear();
+    for (auto it = context.chain.rbegin(); it != context.chain.rend(); it++) {
+        route.junctions.push_back(context.junctions[*it]);
+    }
+
+    route.source_tile = context.sources[frontier.endpoint[best_node]].tile;
+    route.target_tile = context.targets[exits.endpoint[best_node]].tile;
+    route.cost = best;
+}
+
+/*
+    Landmarks are picked farthest-first: each is the junction farthest from
+    every landmark picked before it, and junctions none of them reach (another
+    part of the network) come first of all. Distances are stored per junction
+    so a bound reads one contiguous run of them.
+*/
+void place_landmarks(PathfindingContext& context)
+{
+    const size_t node_count { context.junctions.size() };
+    const size_t landmark_count { std::min(Constants::LANDMARK_COUNT, node_count) };
+
+    context.landmark_count = landmark_count;
+    context.landmark_distances.assign(node_count * landmark_count, UNREACHED);
+    if (landmark_count == 0)
         return;
 
-    int heuristic_val {
-        heuristic(
-            registry.get<const GridPositionComponent>(query_tile).position,
-            registry.get<const GridPositionComponent>(target_tile).position
-        )
+    SearchState& search { context.forward };
+    std::vector<int> nearest(node_count, UNREACHED);
+
+    auto distances_from = [&](uint32_t origin) {
+        search.reset();
+        search.label(origin, 0, NO_NODE, 0);
+        search.push(0, origin);
+
+        while (!search.empty()) {
+            auto [cost, node] { search.pop() };
+            if (cost > search.cost_to(node))
+                continue;
+
+            for (const PathfindingContext::Link& link : context.links[node]) {
+                if (link.node != NO_NODE && cost + link.cost < search.cost_to(link.node)) {
+                    search.label(link.node, cost + link.cost, node, 0);
+                    search.push(cost + link.cost, link.node);
+                }
+            }
+        }
     };
 
-    frontier.push({ query_tile, heuristic_val });
-    came_from.emplace(query_tile, current_tile);
+    auto farthest = [&]() {
+        return static_cast<uint32_t>(std::distance(
+            nearest.begin(),
+            std::max_element(nearest.begin(), nearest.end())
+        ));
+    };
+
+    // Start from whatever lies farthest from an arbitrary junction
+    distances_from(0);
+    for (uint32_t node = 0; node < node_count; node++) {
+        nearest[node] = search.cost_to(node);
+    }
+    uint32_t next { farthest() };
+    std::fill(nearest.begin(), nearest.end(), UNREACHED);
+
+    for (size_t landmark = 0; landmark < landmark_count; landmark++) {
+        distances_from(next);
+
+        for (uint32_t node = 0; node < node_count; node++) {
+            int distance { search.cost_to(node) };
+            context.landmark_distances[node * landmark_count + landmark] = distance;
+            nearest[node] = std::min(nearest[node], distance);
+        }
+
+        next = farthest();
+    }
+}
+
+// Returns the route's cost
+int assemble_path(const JunctionRoute& route, std::vector<entt::entity>& path)
+{
+    path.push_back(route.source_tile);
+    for (entt::entity junction : route.junctions) {
+        if (junction != path.back())
+            path.push_back(junction);
+    }
+
+    if (route.target_tile != path.back())
+        path.push_back(route.target_tile);
+
+    return route.cost;
 }
 
-void query_segment(
+// Whether any source junction is on the same road network as a target; if
+// not, no search could join them
+bool share_network(
+    const PathfindingContext& context,
+    const std::vector<PathEndpoint>& sources,
+    const std::vector<PathEndpoint>& targets
+)
+{
+    for (const PathEndpoint& source : sources) {
+        for (const PathEndpoint& target : targets) {
+            if (context.networks[source.node] == context.networks[target.node])
+                return true;
+        }
+    }
+    return false;
+}
+
+/*
+    Route from whichever of the source tiles gives the cheapest path. Every
+    source seeds the same search, so several candidate starting points cost a
+    single query.
+*/
+int route_between(
     const entt::registry& registry,
-    const SegmentComponent& segment,
-    std::priority_queue<PathStep, std::vector<PathStep>, Compare>& frontier,
-    std::unordered_map<entt::entity, entt::entity>& came_from,
-    entt::entity target_tile,
-    entt::entity current_tile
+    PathfindingContext& context,
+    const entt::entity* from_begin,
+    const entt::entity* from_end,
+    entt::entity to_tile,
+    std::vector<entt::entity>& path
 )
 {
-    auto it {
-        std::find_if(
-            segment.entities.begin(),
-            segment.entities.end(),
-            [&registry, target_tile](entt::entity entity) {
-                return is_goal(registry, target_tile, entity);
-            }
-        )
-    };
+    context.sources.clear();
+    context.targets.clear();
+
+    for (const entt::entity* from_tile = from_begin; from_tile != from_end; from_tile++) {
+        if (*from_tile != to_tile)
+            Pathfinding::source_endpoints(registry, *from_tile, context.sources);
+    }
 
-    // Advance to target tile if it's the goal, else via the origin/termination
-    if (it != segment.entities.end()) {
-        advance(registry, frontier, came_from, current_tile, *it, target_tile);
+    if (context.sources.empty())
+        return Pathfinding::NO_ROUTE;
+
+    Pathfinding::target_endpoints(registry, to_tile, context.targets);
+
+    if (!share_network(context, context.sources, context.targets))
+        return Pathfinding::NO_ROUTE;
+
+    JunctionRoute& route { context.route };
+    route.junctions.clear();
+    route.cost = UNREACHED;
+
+    offer_direct(registry, from_begin, from_end, to_tile, context.targets, route);
+
+    // Answer from the shortcut index whenever the graph has one
+    if (const auto* hierarchy { registry.ctx().find<const ContractionHierarchy>() }) {
+        Hierarchy::query(*hierarchy, context, route);
     } else {
-        for (auto entity : { segment.origin, segment.termination }) {
-            advance(registry, frontier, came_from, current_tile, entity, target_tile);
+        search_route(
+            context,
+            registry.get<const GridPositionComponent>(to_tile).position,
+            route
+        );
+    }
+
+    if (route.cost == UNREACHED)
+        return Pathfinding::NO_ROUTE;
+
+    return assemble_path(route, path);
+}
+
+// Settle the cheapest junction left in a search grown back from a target
+void settle_reverse(const PathfindingContext& context, ReverseSearch& search)
+{
+    SearchState& state { search.state };
+    auto [cost, node] { state.pop() };
+    if (cost > state.cost_to(node))
+        return;
+
+    const int crossing { Pathfinding::crossing_cost(state, search.targets, node) };
+    for (const PathfindingContext::Link& link : context.links[node]) {
+        if (link.node == NO_NODE)
+            continue;
+
+        int next_cost { cost + crossing + link.cost };
+        if (next_cost >= state.cost_to(link.node))
+            continue;
+
+        state.label(link.node, next_cost, node, state.endpoint[node]);
+        state.push(next_cost, link.node);
+    }
+}
+
+// Offer the routes through whichever source endpoints the search has reached
+void offer_sources(
+    const PathfindingContext& context,
+    const ReverseSearch& search,
+    JunctionRoute& route,
+    uint32_t& best_source
+)
+{
+    const SearchState& state { search.state };
+    for (uint32_t index = 0; index < context.sources.size(); index++) {
+        const PathEndpoint& source { context.sources[index] };
+        if (!state.reached(source.node))
+            continue;
+
+        int cost {
+            source.cost + state.cost_to(source.node)
+            + std::min(Pathfinding::crossing_cost(source), Pathfinding::crossing_cost(state, search.targets, source.node))
+        };
+        if (cost < route.cost) {
+            route.source_tile = source.tile;
+            route.cost = cost;
+            best_source = index;
         }
     }
 }
 
+// Finish a route found by searching back from the target; parents lead from
+// the source's junction to the target's
+int follow_reverse_search(
+    PathfindingContext& context,
+    const ReverseSearch& search,
+    uint32_t best_source,
+    std::vector<entt::entity>& path
+)
+{
+    JunctionRoute& route { context.route };
+    if (route.cost == UNREACHED)
+        return Pathfinding::NO_ROUTE;
+
+    if (best_source != NO_NODE) {
+        const SearchState& state { search.state };
+        uint32_t source_node { context.sources[best_source].node };
+
+        for (uint32_t node = source_node; node != NO_NODE; node = state.parent[node]) {
+            route.junctions.push_back(context.junctions[node]);
+        }
+
+        route.target_tile = search.targets[state.endpoint[source_node]].tile;
+    }
+
+    return assemble_path(route, path);
+}
+
 } // namespace
 
 namespace Pathfinding {
 
-void path_between(
+void source_endpoints(
+    const entt::registry& registry,
+    entt::entity tile,
+    std::vector<PathEndpoint>& endpoints
+)
+{
+    if (const JunctionComponent* junction { registry.try_get<const JunctionComponent>(tile) }) {
+        endpoints.push_back({ tile, junction->index, tile, 0 });
+        return;
+    }
+
+    const SegmentMemberComponent* member { registry.try_get<const SegmentMemberComponent>(tile) };
+    if (!member)
+        return;
+
+    const SegmentComponent& segment { registry.get<const SegmentComponent>(member->segment) };
+    int position { member_position(registry, segment, tile) };
+
+    endpoints.push_back({
+        segment.origin,
+        registry.get<const JunctionComponent>(segment.origin).index,
+        tile,
+        position + 1 //
+    });
+
+    endpoints.push_back({
+        segment.termination,
+        registry.get<const JunctionComponent>(segment.termination).index,
+        tile,
+        static_cast<int>(segment.members.size()) - position //
+    });
+}
+
+void target_endpoints(
+    const entt::registry& registry,
+    entt::entity target_tile,
+    std::vector<PathEndpoint>& endpoints
+)
+{
+    using TileMapType = Grid<entt::entity, TileMapProjection>;
+    const TileMapType& tilemap { registry.ctx().get<const TileMapType>() };
+    const glm::ivec2 target_position { registry.get<const GridPositionComponent>(target_tile).position };
+
+    source_endpoints(registry, target_tile, endpoints);
+
+    for (auto direction : Direction::EachDirectionIn { Direction::TDirection::ALL_CARDINAL_DIRECTIONS }) {
+        glm::ivec2 position { target_position + Direction::direction_vectors.at(direction) };
+        if (!tilemap.position_is_valid(position) || tilemap[position] == entt::null)
+            continue;
+
+        source_endpoints(registry, tilemap[position], endpoints);
+    }
+}
+
+int crossing_cost(const PathEndpoint& endpoint)
+{
+    return endpoint.tile == endpoint.junction ? 0 : Constants::JUNCTION_CROSSING_COST;
+}
+
+int crossing_cost(const SearchState& search, const std::vector<PathEndpoint>& endpoints, uint32_t node)
+{
+    if (search.parent[node] == NO_NODE)
+        return crossing_cost(endpoints[search.endpoint[node]]);
+
+    return Constants::JUNCTION_CROSSING_COST;
+}
+
+uint32_t network_of(const entt::registry& registry, entt::entity tile)
+{
+    if (const JunctionComponent* junction { registry.try_get<const JunctionComponent>(tile) })
+        return junction->network;
+
+    if (const SegmentMemberComponent* member { registry.try_get<const SegmentMemberComponent>(tile) })
+        return registry.get<const SegmentComponent>(member->segment).network;
+
+    return NO_NETWORK;
+}
+
+bool connected(
+    const entt::registry& registry,
+    const std::vector<entt::entity>& lhs_tiles,
+    const std::vector<entt::entity>& rhs_tiles
+)
+{
+    for (entt::entity lhs : lhs_tiles) {
+        uint32_t network { network_of(registry, lhs) };
+        if (network == NO_NETWORK)
+            continue;
+
+        for (entt::entity rhs : rhs_tiles) {
+            if (network_of(registry, rhs) == network)
+                return true;
+        }
+    }
+    return false;
+}
+
+// Take a dense copy of the junction graph for the search context
+void prepare(entt::registry& registry)
+{
+    PathfindingContext& context { registry.ctx().emplace<PathfindingContext>() };
+    const RoadGraph& graph { registry.ctx().get<const RoadGraph>() };
+    context.resize(graph.junction_count());
+
+    for (uint32_t node = 0; node < graph.junction_count(); node++) {
+        context.junctions[node] = graph.junctions[node];
+        context.positions[node] = graph.positions[node];
+        context.networks[node] = graph.networks[node];
+
+        for (uint32_t edge = graph.offsets[node]; edge < graph.offsets[node + 1]; edge++) {
+            context.links[node][Direction::index_position(graph.directions[edge])] = {
+                graph.targets[edge],
+                graph.costs[edge]
+            };
+        }
+    }
+
+    // The previous graph's distances mean nothing for this one
+    context.landmark_count = 0;
+    context.landmark_distances.clear();
+}
+
+void prepare_landmarks(entt::registry& registry)
+{
+    place_landmarks(registry.ctx().get<PathfindingContext>());
+}
+
+int path_between(
+    entt::registry& registry,
+    entt::entity from_tile,
+    entt::entity to_tile,
+    std::vector<entt::entity>& path
+)
+{
+    return path_between(registry, registry.ctx().emplace<PathfindingContext>(), from_tile, to_tile, path);
+}
+
+int path_between(
     const entt::registry& registry,
+    PathfindingContext& context,
     entt::entity from_tile,
     entt::entity to_tile,
     std::vector<entt::entity>& path
 )
 {
-    if (
-        from_tile == to_tile
-        || !registry.any_of<JunctionComponent, SegmentMemberComponent>(from_tile)
-    )
-        return;
+    return route_between(registry, context, &from_tile, &from_tile + 1, to_tile, path);
+}
 
-    std::priority_queue<PathStep, std::vector<PathStep>, Compare> frontier;
-    std::unordered_map<entt::entity, entt::entity> came_from;
-
-    if (registry.all_of<SegmentMemberComponent>(from_tile)) {
-        query_segment(
-            registry,
-            registry.get<SegmentComponent>(registry.get<SegmentMemberComponent>(from_tile).segment),
-            frontier,
-            came_from,
-            to_tile,
-            from_tile
-        );
-    } else {
-        frontier.push({ from_tile, 0 });
+int path_between(
+    entt::registry& registry,
+    const std::vector<entt::entity>& from_tiles,
+    entt::entity to_tile,
+    std::vector<entt::entity>& path
+)
+{
+    return path_between(registry, registry.ctx().emplace<PathfindingContext>(), from_tiles, to_tile, path);
+}
+
+int path_between(
+    const entt::registry& registry,
+    PathfindingContext& context,
+    const std::vector<entt::entity>& from_tiles,
+    entt::entity to_tile,
+    std::vector<entt::entity>& path
+)
+{
+    return route_between(registry, context, from_tiles.data(), from_tiles.data() + from_tiles.size(), to_tile, path);
+}
+
+void prepare_reverse_search(
+    const entt::registry& registry,
+    const PathfindingContext& context,
+    ReverseSearch& search,
+    entt::entity target_tile
+)
+{
+    SearchState& state { search.state };
+    if (state.cost.size() != context.junctions.size())
+        state.resize(context.junctions.size());
+
+    state.reset();
+    search.target_tile = target_tile;
+    search.targets.clear();
+    target_endpoints(registry, target_tile, search.targets);
+
+    for (uint32_t index = 0; index < search.targets.size(); index++) {
+        const PathEndpoint& target { search.targets[index] };
+        if (target.cost >= state.cost_to(target.node))
+            continue;
+
+        state.label(target.node, target.cost, NO_NODE, index);
+        state.push(target.cost, target.node);
     }
+}
 
-    while (!frontier.empty()) {
-        PathStep current { frontier.top() };
-        frontier.pop();
+int path_between(
+    const entt::registry& registry,
+    PathfindingContext& context,
+    ReverseSearch& search,
+    entt::entity from_tile,
+    std::vector<entt::entity>& path
+)
+{
+    context.sources.clear();
+    source_endpoints(registry, from_tile, context.sources);
 
-        if (is_goal(registry, to_tile, current.tile)) {
-            came_from.emplace(to_tile, current.tile);
-            break;
-        }
+    // Otherwise the search would settle the whole of the target's network
+    if (!share_network(context, context.sources, search.targets))
+        return NO_ROUTE;
 
-        for (auto segment_entity : registry.get<JunctionComponent>(current.tile).connections) {
-            if (segment_entity == entt::null)
-                continue;
+    JunctionRoute& route { context.route };
+    route.junctions.clear();
+    route.cost = UNREACHED;
 
-            query_segment(
-                registry,
-                registry.get<SegmentComponent>(segment_entity),
-                frontier,
-                came_from,
-                to_tile,
-                current.tile
-            );
-        }
+    // Unlike a fresh search, the source may already stand on the goal
+    offer_direct(registry, &from_tile, &from_tile + 1, entt::null, search.targets, route);
+
+    int closest_source { UNREACHED };
+    for (const PathEndpoint& source : context.sources) {
+        closest_source = std::min(closest_source, source.cost);
     }
 
-    if (came_from.find(to_tile) == came_from.end())
-        return;
+    uint32_t best_source { NO_NODE };
+    SearchState& state { search.state };
+    offer_sources(context, search, route, best_source);
 
-    for (
-        entt::entity current = came_from.at(to_tile);
-        current != from_tile;
-        current = came_from.at(current)
+    // Settle junctions until none left unsettled could offer a cheaper route
+    while (
+        closest_source != UNREACHED
+        && !state.empty()
+        && state.next_priority() + closest_source < route.cost
     ) {
-        path.push_back(current);
+        settle_reverse(context, search);
+        offer_sources(context, search, route, best_source);
     }
 
-    path.push_back(from_tile);
-    std::reverse(path.begin(), path.end());
+    return follow_reverse_search(context, search, best_source, path);
 }
 
-void expand_path(
-    entt::registry& registry,
+void build_flow_field(
+    const entt::registry& registry,
+    const PathfindingContext& context,
+    ReverseSearch& field,
+    entt::entity target_tile
+)
+{
+    prepare_reverse_search(registry, context, field, target_tile);
+    while (!field.state.empty()) {
+        settle_reverse(context, field);
+    }
+}
+
+int path_from_field(
+    const entt::registry& registry,
+    PathfindingContext& context,
+    const ReverseSearch& field,
+    const std::vector<entt::entity>& from_tiles,
+    std::vector<entt::entity>& path
+)
+{
+    context.sources.clear();
+    for (entt::entity from_tile : from_tiles) {
+        if (from_tile != field.target_tile)
+            source_endpoints(registry, from_tile, context.sources);
+    }
+
+    JunctionRoute& route { context.route };
+    route.junctions.clear();
+    route.cost = UNREACHED;
+
+    offer_direct(
+        registry,
+        from_tiles.data(),
+        from_tiles.data() + from_tiles.size(),
+        field.target_tile,
+        field.targets,
+        route
+    );
+
+    uint32_t best_source { NO_NODE };
+    offer_sources(context, field, route, best_source);
+    return follow_reverse_search(context, field, best_source, path);
+}
+
+bool next_segment(
+    const entt::registry& registry,
     const std::vector<entt::entity>& path,
-    std::vector<PathSegment>& expanded_path
+    RouteCursor& cursor,
+    PathSegment& segment
 )
 {
-    Direction::TDirection incoming_direction { Direction::TDirection::NO_DIRECTION };
-    glm::ivec2 current_grid_position { registry.get<const GridPositionComponent>(path.front()).position };
-    glm::ivec2 current_transform_abs { registry.get<const TransformComponent>(path.front()).position };
+    if (cursor.leg + 1 >= path.size())
+        return false;
 
-    for (size_t index = 0; index < path.size() - 1; index++) {
-        const glm::ivec2 next_grid_position { registry.get<const GridPositionComponent>(path.at(index + 1)).position };
-        const glm::ivec2 next_transform_abs { registry.get<const TransformComponent>(path.at(index + 1)).position };
+    const entt::entity current { path[cursor.leg] };
+    const glm::ivec2 current_grid_position { registry.get<const GridPositionComponent>(current).position };
+    const glm::ivec2 current_transform_abs { registry.get<const TransformComponent>(current).position };
+    const glm::ivec2 next_grid_position { registry.get<const GridPositionComponent>(path[cursor.leg + 1]).position };
 
-        Direction::TDirection outgoing_direction {
-            Direction::from_vector(next_grid_position - current_grid_position)
-        };
+    Direction::TDirection outgoing_direction {
+        Direction::from_vector(next_grid_position - current_grid_position)
+    };
 
-        Direction::TDirection reverse_outgoing_direction {
-            Direction::reverse(outgoing_direction)
+    glm::vec2 outgoing_exit {
+        current_transform_abs
+        + Constants::ROAD_GATES.at(index_position(outgoing_direction)).exit
+    };
+
+    // A step to traverse a junction comes before leaving it
+    if (!cursor.crossed && cursor.leg != 0 && registry.all_of<JunctionComponent>(current)) {
+        const glm::ivec2 previous_grid_position { registry.get<const GridPositionComponent>(path[cursor.leg - 1]).position };
+        Direction::TDirection incoming_direction {
+            Direction::from_vector(current_grid_position - previous_grid_position)
         };
 
-        glm::vec2 outgoing_exit {
-            current_transform_abs
-            + Constants::ROAD_GATES.at(index_position(outgoing_direction)).exit
+        segment = {
+            current_transform_abs + Constants::ROAD_GATES.at(index_position(Direction::reverse(incoming_direction))).entry,
+            outgoing_exit,
+            incoming_direction | outgoing_direction
         };
+        cursor.crossed = true;
+        return true;
+    }
 
-        // Add a step to traverse a junction
-        if (index != 0 && registry.all_of<JunctionComponent>(path.at(index))) {
-            expanded_path.emplace_back(
-                current_transform_abs + Constants::ROAD_GATES.at(index_position(Direction::reverse(incoming_direction))).entry,
-                outgoing_exit,
-                incoming_direction | outgoing_direction
-            );
-        }
+    const glm::ivec2 next_transform_abs { registry.get<const TransformComponent>(path[cursor.leg + 1]).position };
+    segment = {
+        outgoing_exit,
+        next_transform_abs + Constants::ROAD_GATES.at(index_position(Direction::reverse(outgoing_direction))).entry,
+        outgoing_direction
+    };
+    cursor.leg++;
+    cursor.crossed = false;
+    return true;
+}
 
-        expanded_path.emplace_back(
-            outgoing_exit,
-            next_transform_abs + Constants::ROAD_GATES.at(index_position(reverse_outgoing_direction)).entry,
-            outgoing_direction
-        );
+void expand_path(
+    const entt::registry& registry,
+    const std::vector<entt::entity>& path,
+    std::vector<PathSegment>& expanded_path
+)
+{
+    RouteCursor cursor {};
+    PathSegment segment { {}, {}, Direction::TDirection::NO_DIRECTION };
 
-        incoming_direction = outgoing_direction;
-        current_grid_position = next_grid_position;
-        current_transform_abs = next_transform_abs;
+    while (next_segment(registry, path, cursor, segment)) {
+        expanded_path.push_back(segment);
     }
-    [[maybe_unused]] const GridPositionComponent& last_pos { registry.get<const GridPositionComponent>(path.back()) };
 }
 
 } // namespace
\ No newline at end of file
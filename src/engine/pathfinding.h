@@ -3,23 +3,156 @@
 
 #include <components/path_component.h>
 #include <components/segment_component.h>
+#include <cstdint>
 #include <directions.h>
 #include <entt/entt.hpp>
 #include <vector>
 
-struct PathSegment;
+struct PathfindingContext;
+struct ReverseSearch;
+struct SearchState;
+
+// A junction through which a tile joins the road graph, and the cost of the
+// walk between the two
+struct PathEndpoint {
+    entt::entity junction;
+    uint32_t node;
+    entt::entity tile;
+    int cost;
+};
+
+// The junctions crossed between two endpoints, and the tiles either side
+struct JunctionRoute {
+    std::vector<entt::entity> junctions;
+    entt::entity source_tile;
+    entt::entity target_tile;
+    int cost;
+};
 
 namespace Pathfinding {
 
-void path_between(
+// Returned by path_between when the target can't be reached
+inline constexpr int NO_ROUTE { -1 };
+
+// The network of a tile that isn't on the road
+inline constexpr uint32_t NO_NETWORK { UINT32_MAX };
+
+// The connected road network the tile is part of
+uint32_t network_of(const entt::registry& registry, entt::entity tile);
+
+// Whether any of the road tiles shares a network with any of the others, so
+// a path between them might exist
+bool connected(
+    const entt::registry& registry,
+    const std::vector<entt::entity>& lhs_tiles,
+    const std::vector<entt::entity>& rhs_tiles
+);
+
+void source_endpoints(
+    const entt::registry& registry,
+    entt::entity tile,
+    std::vector<PathEndpoint>& endpoints
+);
+
+void target_endpoints(
+    const entt::registry& registry,
+    entt::entity target_tile,
+    std::vector<PathEndpoint>& endpoints
+);
+
+// Crossing a junction costs JUNCTION_CROSSING_COST, unless the walk starts
+// or ends on it; segment and endpoint costs count steps only
+int crossing_cost(const PathEndpoint& endpoint);
+
+// The crossing charged to leave a junction reached by the search: nothing
+// for an endpoint standing on it, otherwise a full crossing
+int crossing_cost(const SearchState& search, const std::vector<PathEndpoint>& endpoints, uint32_t node);
+
+// Copy the latest RoadGraph into the search context, without landmarks
+void prepare(entt::registry& registry);
+
+// Place the landmarks over the prepared context; searches go without the
+// landmark bound until this is done
+void prepare_landmarks(entt::registry& registry);
+
+// Each returns the cost of the path found, or NO_ROUTE
+
+int path_between(
+    entt::registry& registry,
+    entt::entity from_tile,
+    entt::entity to_tile,
+    std::vector<entt::entity>& path
+);
+
+int path_between(
     const entt::registry& registry,
+    PathfindingContext& context,
     entt::entity from_tile,
     entt::entity to_tile,
     std::vector<entt::entity>& path
 );
 
-void expand_path(
+// The best path from any of the tiles, found in a single search
+int path_between(
     entt::registry& registry,
+    const std::vector<entt::entity>& from_tiles,
+    entt::entity to_tile,
+    std::vector<entt::entity>& path
+);
+
+int path_between(
+    const entt::registry& registry,
+    PathfindingContext& context,
+    const std::vector<entt::entity>& from_tiles,
+    entt::entity to_tile,
+    std::vector<entt::entity>& path
+);
+
+// Start a search back from the target that path_between can then resume
+void prepare_reverse_search(
+    const entt::registry& registry,
+    const PathfindingContext& context,
+    ReverseSearch& search,
+    entt::entity target_tile
+);
+
+int path_between(
+    const entt::registry& registry,
+    PathfindingContext& context,
+    ReverseSearch& search,
+    entt::entity from_tile,
+    std::vector<entt::entity>& path
+);
+
+// Search back from the target to every junction; paths can then be read from
+// the field without searching
+void build_flow_field(
+    const entt::registry& registry,
+    const PathfindingContext& context,
+    ReverseSearch& field,
+    entt::entity target_tile
+);
+
+// The best path from any of the tiles, read from a built flow field
+int path_from_field(
+    const entt::registry& registry,
+    PathfindingContext& context,
+    const ReverseSearch& field,
+    const std::vector<entt::entity>& from_tiles,
+    std::vector<entt::entity>& path
+);
+
+// Generate the segment after the cursor and move the cursor past it; false
+// once the route is done
+bool next_segment(
+    const entt::registry& registry,
+    const std::vector<entt::entity>& path,
+    RouteCursor& cursor,
+    PathSegment& segment
+);
+
+void expand_path(
+    const entt::registry& registry,
     const std::vector<entt::entity>& path,
     std::vector<PathSegment>& expanded_path
 );
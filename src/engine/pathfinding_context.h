@@ -0,0 +1,166 @@
+#ifndef PATHFINDINGCONTEXT_H
+#define PATHFINDINGCONTEXT_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <functional>
+#include <glm/glm.hpp>
+#include <limits>
+#include <pathfinding.h>
+#include <vector>
+
+/*
+    Per-junction search state, indexed by JunctionComponent::index.
+
+    Entries are only valid where their stamp matches the current generation,
+    so a new search clears everything by bumping the generation instead of
+    touching the arrays. The frontier is a binary heap over a vector reserved
+    up front; once the vectors have grown to fit the graph a search does not
+    allocate.
+*/
+struct SearchState {
+    static constexpr uint32_t NO_NODE { UINT32_MAX };
+
+    struct Entry {
+        int priority;
+        uint32_t node;
+
+        bool operator>(const Entry& comparator) const
+        {
+            return priority > comparator.priority;
+        }
+    };
+
+    std::vector<int> cost;
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> endpoint;
+    std::vector<uint32_t> stamp;
+    uint32_t generation { 0 };
+    std::vector<Entry> frontier;
+
+    void resize(size_t node_count)
+    {
+        cost.assign(node_count, 0);
+        parent.assign(node_count, NO_NODE);
+        endpoint.assign(node_count, 0);
+        stamp.assign(node_count, 0);
+        generation = 0;
+
+        frontier.clear();
+        frontier.reserve(node_count * 4 + 8);
+    }
+
+    void reset()
+    {
+        if (++generation == 0) {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
+        frontier.clear();
+    }
+
+    bool reached(uint32_t node) const { return stamp[node] == generation; }
+
+    int cost_to(uint32_t node) const
+    {
+        return reached(node) ? cost[node] : std::numeric_limits<int>::max();
+    }
+
+    void label(uint32_t node, int node_cost, uint32_t node_parent, uint32_t node_endpoint)
+    {
+        cost[node] = node_cost;
+        parent[node] = node_parent;
+        endpoint[node] = node_endpoint;
+        stamp[node] = generation;
+    }
+
+    void push(int priority, uint32_t node)
+    {
+        frontier.push_back({ priority, node });
+        std::push_heap(frontier.begin(), frontier.end(), std::greater<Entry> {});
+    }
+
+    Entry pop()
+    {
+        std::pop_heap(frontier.begin(), frontier.end(), std::greater<Entry> {});
+        Entry entry { frontier.back() };
+        frontier.pop_back();
+        return entry;
+    }
+
+    bool empty() const { return frontier.empty(); }
+
+    int next_priority() const
+    {
+        return frontier.empty() ? std::numeric_limits<int>::max() : frontier.front().priority;
+    }
+};
+
+/*
+    Everything Pathfinding needs to answer a query without touching the
+    registry or the allocator: the junction graph unpacked from the RoadGraph
+    each time GraphSystem rebuilds it, plus reusable search state and scratch.
+*/
+struct PathfindingContext {
+    struct Link {
+        uint32_t node;
+        int cost;
+    };
+
+    // Indexed by JunctionComponent::index; links by Direction::index_position
+    std::vector<entt::entity> junctions;
+    std::vector<glm::ivec2> positions;
+    std::vector<std::array<Link, 4>> links;
+    std::vector<uint32_t> networks;
+
+    SearchState forward;
+    SearchState backward;
+
+    // Distance from each landmark, landmark_count per junction
+    std::vector<int> landmark_distances;
+    size_t landmark_count { 0 };
+    bool use_landmarks { true };
+
+    std::vector<PathEndpoint> sources;
+    std::vector<PathEndpoint> targets;
+    std::vector<uint32_t> chain;
+    std::vector<int> estimates;
+    JunctionRoute route;
+
+    // Debug counters, accumulated until read
+    uint64_t searches { 0 };
+    uint64_t expanded { 0 };
+
+    void resize(size_t junction_count)
+    {
+        junctions.assign(junction_count, entt::null);
+        positions.assign(junction_count, glm::ivec2 {});
+        networks.assign(junction_count, 0);
+        links.resize(junction_count);
+        for (auto& junction_links : links) {
+            junction_links.fill({ SearchState::NO_NODE, 0 });
+        }
+
+        forward.resize(junction_count);
+        backward.resize(junction_count);
+        chain.reserve(junction_count);
+        estimates.assign(junction_count, 0);
+        route.junctions.reserve(junction_count);
+    }
+};
+
+/*
+    Dijkstra grown outward from the exits of one target tile, so costs and
+    parents lead to the target. A settled junction's route is final for every
+    later query towards the same target; each query resumes the search only
+    as far as it needs to, and the frontier is kept between them.
+*/
+struct ReverseSearch {
+    entt::entity target_tile { entt::null };
+    std::vector<PathEndpoint> targets;
+    SearchState state;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef ROADGRAPH_H
+#define ROADGRAPH_H
+
+#include <cstdint>
+#include <directions.h>
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+
+/*
+    Compressed sparse row copy of the junction graph, taken each time
+    GraphSystem changes it, so that traversals can run over contiguous arrays
+    instead of through JunctionComponent and SegmentComponent lookups.
+
+    Each segment appears once from either end. A junction's edges are listed
+    in Direction::index_position order of the direction they leave it by.
+*/
+struct RoadGraph {
+    // GraphStateComponent::generation the snapshot was taken at
+    uint64_t generation { 0 };
+
+    // Indexed by JunctionComponent::index
+    std::vector<entt::entity> junctions;
+    std::vector<glm::ivec2> positions;
+    std::vector<uint32_t> networks;
+
+    // Edges of junction n are edge[offsets[n]] to edge[offsets[n + 1]]
+    std::vector<uint32_t> offsets;
+
+    // By edge
+    std::vector<uint32_t> targets;
+    std::vector<int> costs;
+    std::vector<Direction::TDirection> directions;
+    std::vector<entt::entity> segments;
+
+    size_t junction_count() const { return junctions.size(); }
+    size_t edge_count() const { return targets.size(); }
+
+    void clear()
+    {
+        junctions.clear();
+        positions.clear();
+        networks.clear();
+        offsets.clear();
+        targets.clear();
+        costs.clear();
+        directions.clear();
+        segments.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <entt/entt.hpp>
+#include <memory>
+#include <route_store.h>
+#include <vector>
+
+namespace {
+// FNV-1a over the tiles of the route
+uint64_t signature(const std::vector<entt::entity>& route)
+{
+    uint64_t hash { 14695981039346656037ull };
+    for (entt::entity tile : route) {
+        hash ^= entt::to_integral(tile);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+}
+
+Route RouteStore::intern(const std::vector<entt::entity>& route)
+{
+    uint64_t key { signature(route) };
+
+    auto [first, last] { routes.equal_range(key) };
+    for (auto it = first; it != last; it++) {
+        if (Route shared { it->second.lock() }; shared && *shared == route)
+            return shared;
+    }
+
+    if (routes.size() >= sweep_at)
+        sweep();
+
+    Route shared { std::make_shared<const std::vector<entt::entity>>(route) };
+    routes.emplace(key, shared);
+    return shared;
+}
+
+Route RouteStore::reversed(const Route& route)
+{
+    return intern(std::vector<entt::entity>(route->rbegin(), route->rend()));
+}
+
+size_t RouteStore::size() const
+{
+    return std::count_if(routes.begin(), routes.end(), [](const auto& entry) {
+        return !entry.second.expired();
+    });
+}
+
+// Drop the routes nobody holds any more; amortised by letting the store
+// double between sweeps
+void RouteStore::sweep()
+{
+    for (auto it = routes.begin(); it != routes.end();) {
+        if (it->second.expired())
+            it = routes.erase(it);
+        else
+            it++;
+    }
+
+    sweep_at = std::max<size_t>(64, routes.size() * 2);
+}
@@ -0,0 +1,36 @@
+#ifndef ROUTESTORE_H
+#define ROUTESTORE_H
+
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// A route shared between every walker making the same trip; never modified
+// once interned, and freed with the last walker or cache entry holding it
+using Route = std::shared_ptr<const std::vector<entt::entity>>;
+
+/*
+    Interns routes by their sequence of tiles, so identical trips share one
+    buffer rather than each walker holding a copy. The store only keeps weak
+    references; entries whose route has been freed are swept out as the
+    store grows.
+*/
+class RouteStore {
+    std::unordered_multimap<uint64_t, std::weak_ptr<const std::vector<entt::entity>>> routes;
+    size_t sweep_at { 64 };
+
+    void sweep();
+
+public:
+    Route intern(const std::vector<entt::entity>& route);
+
+    // The same trip walked the other way, for a return journey
+    Route reversed(const Route& route);
+
+    // Routes still held by a walker or the cache
+    size_t size() const;
+};
+
+#endif
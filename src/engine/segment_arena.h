@@ -0,0 +1,61 @@
+#ifndef SEGMENTARENA_H
+#define SEGMENTARENA_H
+
+#include <components/segment_component.h>
+#include <cstddef>
+#include <cstdint>
+#include <entt/entt.hpp>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+/*
+    The member tiles of every segment, end to end in one buffer owned by the
+    road graph; each SegmentComponent holds the offset and length of its own
+    run. New segments are appended, and the runs of released segments are
+    reclaimed by compacting the buffer once they take up most of it.
+*/
+struct SegmentArena {
+    struct Range {
+        const entt::entity* first;
+        const entt::entity* last;
+
+        const entt::entity* begin() const { return first; }
+        const entt::entity* end() const { return last; }
+        size_t size() const { return last - first; }
+    };
+
+    std::vector<entt::entity> members;
+    // Compaction target, kept to reuse its allocation
+    std::vector<entt::entity> spare;
+    // Members of destroyed segments, still taking up space
+    size_t released { 0 };
+
+    // Whether a run, e.g. one read from a save, lies within the buffer
+    bool holds(const SegmentMembers& run) const
+    {
+        return run.offset <= members.size() && run.count <= members.size() - run.offset;
+    }
+
+    // Valid until the next append or compaction
+    Range of(const SegmentMembers& run) const
+    {
+        return { members.data() + run.offset, members.data() + run.offset + run.count };
+    }
+
+    SegmentMembers append(const entt::entity* first, const entt::entity* last)
+    {
+        SegmentMembers run { static_cast<uint32_t>(members.size()), static_cast<uint32_t>(last - first) };
+        members.insert(members.end(), first, last);
+        return run;
+    }
+
+    void clear()
+    {
+        members.clear();
+        released = 0;
+    }
+
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE(SegmentArena, members, released)
+};
+
+#endif
@@ -16,6 +16,7 @@ SpriteDefinition::SpriteDefinition(nlohmann::json input, SDL_Surface* surface)
             ? Direction::TDirection(input["directions"].get<uint8_t>())
             : Direction::TDirection::NO_DIRECTION
     }
+    , passable { input.contains("passable") ? input["passable"].get<bool>() : true }
     , spritemask { SpriteMask::get_mask(surface, source_rect, name), //
                    glm::ivec2 { 1, 1 }, //
                    glm::ivec2 { source_rect.w, source_rect.h } }
@@ -29,6 +29,8 @@ struct SpriteDefinition {
     SpriteType sprite_type;
     glm::ivec2 anchor;
     Direction::TDirection directions;
+    // Whether walkers can cross the tile off-road
+    bool passable;
     Grid<bool, SpriteMaskProjection> spritemask;
     SpriteDefinition(nlohmann::json input, SDL_Surface* surface);
 };
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <components/building_pair_component.h>
 #include <components/flags.h>
 #include <components/junction_component.h>
@@ -6,10 +7,12 @@
 #include <components/sprite_component.h>
 #include <entt/entt.hpp>
 #include <grid.h>
+#include <pathfinding.h>
 #include <position.h>
 #include <projection.h>
 #include <sprite.h>
 #include <systems/building_system.h>
+#include <vector>
 
 namespace {
 
@@ -62,6 +65,16 @@ void unpair(entt::registry& registry, entt::entity entity)
         registry.remove<BuildingPairComponent>(paired_entity);
     }
 }
+
+// Whether the buildings' road access shares a road network
+bool reachable(const entt::registry& registry, entt::entity sender, entt::entity receiver)
+{
+    const RoadAccessComponent* sender_access { registry.try_get<const RoadAccessComponent>(sender) };
+    const RoadAccessComponent* receiver_access { registry.try_get<const RoadAccessComponent>(receiver) };
+
+    return sender_access && receiver_access
+        && Pathfinding::connected(registry, sender_access->road_access_points, receiver_access->road_access_points);
+}
 }
 
 namespace BuildingSystem {
@@ -109,17 +122,33 @@ void update(entt::registry& registry)
         registry.view<ReceiverFlag>(entt::exclude<BuildingPairComponent>)
     };
 
-    auto sendersIt { unpaired_senders.begin() };
-    auto receiversIt { unpaired_receivers.begin() };
-
-    while (
-        sendersIt != unpaired_senders.end()
-        && receiversIt != unpaired_receivers.end()
-    ) {
-        entt::entity sender { *sendersIt++ };
-        entt::entity receiver { *receiversIt++ };
-        registry.emplace<BuildingPairComponent>(sender, receiver);
-        registry.emplace<BuildingPairComponent>(receiver, sender);
+    if (
+        unpaired_senders.begin() == unpaired_senders.end()
+        || unpaired_receivers.begin() == unpaired_receivers.end()
+    )
+        return;
+
+    std::vector<entt::entity> senders { unpaired_senders.begin(), unpaired_senders.end() };
+    std::vector<entt::entity> receivers { unpaired_receivers.begin(), unpaired_receivers.end() };
+
+    for (entt::entity sender : senders) {
+        if (receivers.empty())
+            break;
+
+        // Prefer a receiver the sender can reach by road; otherwise take the
+        // first, as a road may yet join them
+        auto receiver {
+            std::find_if(receivers.begin(), receivers.end(), [&registry, sender](entt::entity candidate) {
+                return reachable(registry, sender, candidate);
+            })
+        };
+
+        if (receiver == receivers.end())
+            receiver = receivers.begin();
+
+        registry.emplace<BuildingPairComponent>(sender, *receiver);
+        registry.emplace<BuildingPairComponent>(*receiver, sender);
+        receivers.erase(receiver);
     }
 }
 
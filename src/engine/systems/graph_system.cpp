@@ -1,122 +1,203 @@
 #include <algorithm>
+#include <chrono>
 #include <components/connectivity_component.h>
 #include <components/flags.h>
+#include <components/graph_state_component.h>
 #include <components/junction_component.h>
 #include <components/segment_component.h>
 #include <components/segment_member_component.h>
 #include <components/transform_component.h>
+#include <constants.h>
+#include <connectivity_grid.h>
+#include <contraction_hierarchy.h>
 #include <directions.h>
 #include <flags.h>
+#include <functional>
 #include <grid.h>
 #include <iterator>
+#include <numeric>
+#include <pathfinding.h>
 #include <projection.h>
+#include <road_graph.h>
+#include <segment_arena.h>
+#include <spdlog/spdlog.h>
 #include <systems/graph_system.h>
+#include <unordered_map>
+#include <worker_pool.h>
 
 #include <entt/entt.hpp>
 
 namespace {
-bool reciprocate(
-    const entt::registry& registry,
-    entt::entity lhs,
-    entt::entity rhs,
-    Direction::TDirection direction
+
+// Junctions, or words of packed tiles, given to a worker at a time during a full rebuild
+constexpr size_t REBUILD_SLICE_SIZE { 1024 };
+
+size_t slice_count(size_t item_count)
+{
+    return (item_count + REBUILD_SLICE_SIZE - 1) / REBUILD_SLICE_SIZE;
+}
+
+// Run the job over each slice of the items, across the worker pool if there
+// is one. Jobs may only read the registry; each writes its own slice's output.
+void run_slices(
+    entt::registry& registry,
+    size_t item_count,
+    const std::function<void(size_t slice, size_t begin, size_t end)>& slice_job
 )
 {
-    const ConnectivityComponent& lhs_component {
-        registry.get<const ConnectivityComponent>(lhs)
-    };
+    auto job { [&](size_t, size_t slice) {
+        slice_job(slice, slice * REBUILD_SLICE_SIZE, std::min(item_count, (slice + 1) * REBUILD_SLICE_SIZE));
+    } };
 
-    const ConnectivityComponent* rhs_component {
-        registry.try_get<const ConnectivityComponent>(rhs)
-    };
+    if (WorkerPool* pool { registry.ctx().find<WorkerPool>() }) {
+        pool->run(slice_count(item_count), job);
+        return;
+    }
 
-    if (!rhs_component)
-        return false;
+    for (size_t slice = 0; slice < slice_count(item_count); slice++) {
+        job(0, slice);
+    }
+}
 
-    return (
-        Direction::any(lhs_component.directions & direction)
-        && Direction::any(rhs_component->directions & Direction::reverse(direction))
-    );
+bool tags_as_junction(const ConnectivityGrid& connectivity, glm::ivec2 grid_position)
+{
+    Direction::TDirection directions { connectivity.at(grid_position) };
+    Direction::TDirection resolved_directions { Direction::TDirection::NO_DIRECTION };
+
+    for (auto direction : Direction::EachDirectionIn { directions }) {
+        if (connectivity.reciprocate(grid_position, direction))
+            resolved_directions = resolved_directions | direction;
+    }
+
+    return Direction::is_junction(directions) || Direction::is_junction(resolved_directions);
 }
 
-Direction::TDirection resolved_directions(
-    entt::registry& registry,
-    Direction::TDirection unresolved_directions,
-    glm::ivec2 grid_position
-)
+// Tag every junction on the map, sixteen tiles a word at a time; the words
+// are checked in parallel and tagged slice by slice, in tile order
+void tag_junctions(entt::registry& registry)
 {
     const Grid<entt::entity, TileMapProjection>& tilemap {
         registry.ctx().get<const Grid<entt::entity, TileMapProjection>>()
     };
+    const ConnectivityGrid& connectivity { registry.ctx().get<const ConnectivityGrid>() };
 
-    Direction::TDirection resolved_directions { Direction::TDirection::NO_DIRECTION };
+    std::vector<std::vector<entt::entity>> junctions(slice_count(connectivity.words.size()));
 
-    for (
-        auto direction : Direction::EachDirectionIn { unresolved_directions }
-    ) {
-        glm::ivec2 step { Direction::direction_vectors.at(direction) };
-        entt::entity next { tilemap[grid_position + step] };
+    run_slices(registry, connectivity.words.size(), [&](size_t slice, size_t begin, size_t end) {
+        for (size_t word = begin; word < end; word++) {
+            uint64_t junction_bits {
+                ConnectivityGrid::junction_nibbles(connectivity.words[word])
+                | ConnectivityGrid::junction_nibbles(connectivity.resolved(word))
+            };
 
-        if (
-            next != entt::null
-            && reciprocate(registry, tilemap[grid_position], next, direction)
-        )
-            resolved_directions = resolved_directions | direction;
+            glm::ivec2 first_tile {
+                int(word % connectivity.row_words) * ConnectivityGrid::TILES_PER_WORD,
+                int(word / connectivity.row_words)
+            };
+
+            while (junction_bits) {
+                int tile { __builtin_ctzll(junction_bits) / 4 };
+                junctions[slice].push_back(tilemap[first_tile + glm::ivec2 { tile, 0 }]);
+                junction_bits &= junction_bits - 1;
+            }
+        }
+    });
+
+    for (const std::vector<entt::entity>& slice_junctions : junctions) {
+        for (auto tile : slice_junctions) {
+            registry.emplace<JunctionComponent>(tile);
+        }
     }
-    return resolved_directions;
 }
 
-void tag_junctions(entt::registry& registry)
+// Append the tiles walked from the position to the next junction in the
+// direction, both ends included; returns how many were appended
+template <typename IsJunction>
+size_t walk_segment(
+    const Grid<entt::entity, TileMapProjection>& tilemap,
+    const ConnectivityGrid& connectivity,
+    const IsJunction& is_junction,
+    glm::ivec2 position,
+    Direction::TDirection direction,
+    std::vector<entt::entity>& output
+)
 {
-    auto connectivity_view { registry.view<ConnectivityComponent, GridPositionComponent>() };
-    for (auto [entity, connectivity, grid_position] : connectivity_view.each()) {
-        if (
-            connectivity.is_junction
-            || Direction::is_junction(
-                resolved_directions(
-                    registry, connectivity.directions, grid_position.position
-                )
-            )
-        ) {
-            registry.emplace_or_replace<JunctionComponent>(entity);
-        }
+    const glm::ivec2 step { Direction::direction_vectors.at(direction) };
+    const glm::ivec2 start { position };
+    const size_t first { output.size() };
+
+    while (true) {
+        output.push_back(tilemap[position]);
+
+        if (position != start && is_junction(position))
+            break;
+
+        if (!connectivity.reciprocate(position, direction))
+            break;
+
+        position += step;
     }
+
+    return output.size() - first;
 }
 
-std::vector<entt::entity> get_segment_from(
+// As walk_segment, between the tiles tagged as junctions in the registry
+size_t get_segment_from(
     const entt::registry& registry,
     entt::entity tile,
-    Direction::TDirection direction
+    Direction::TDirection direction,
+    std::vector<entt::entity>& output
 )
 {
     const Grid<entt::entity, TileMapProjection>& tilemap {
         registry.ctx().get<const Grid<entt::entity, TileMapProjection>>()
     };
 
-    std::vector<entt::entity> output;
-    entt::entity current_entity { tile };
-    glm::ivec2 current_position { registry.get<GridPositionComponent>(current_entity).position };
+    return walk_segment(
+        tilemap,
+        registry.ctx().get<const ConnectivityGrid>(),
+        [&](glm::ivec2 position) { return registry.all_of<JunctionComponent>(tilemap[position]); },
+        registry.get<const GridPositionComponent>(tile).position,
+        direction,
+        output
+    );
+}
 
-    while (true) {
-        output.push_back(current_entity);
+// Create the segment walked over the tiles, the junctions at either end
+// included, and link it to those junctions
+void segment_create(
+    entt::registry& registry,
+    const entt::entity* first,
+    const entt::entity* last,
+    Direction::TDirection direction
+)
+{
+    SegmentArena& arena { registry.ctx().get<SegmentArena>() };
+    entt::entity segment_entity { registry.create() };
 
-        if (current_entity != tile && registry.all_of<JunctionComponent>(current_entity))
-            break;
+    SegmentComponent& segment_component {
+        registry.emplace<SegmentComponent>(
+            segment_entity,
+            *first,
+            *(last - 1),
+            direction,
+            arena.append(first + 1, last - 1)
+        )
+    };
 
-        glm::ivec2 next_position { current_position + Direction::direction_vectors.at(direction) };
-        entt::entity next_entity { tilemap[next_position] };
+    // Every tile stepped to reach the far junction
+    segment_component.cost = static_cast<int>(last - first) - 1;
 
-        if (
-            next_entity == entt::null
-            || !reciprocate(registry, current_entity, next_entity, direction)
-        )
-            break;
+    JunctionComponent& origin {
+        registry.get<JunctionComponent>(segment_component.origin)
+    };
 
-        current_entity = next_entity;
-        current_position = next_position;
-    }
+    JunctionComponent& termination {
+        registry.get<JunctionComponent>(segment_component.termination)
+    };
 
-    return output;
+    origin.connections[Direction::index_position(direction)] = segment_entity;
+    termination.connections[Direction::index_position(Direction::reverse(direction))] = segment_entity;
 }
 
 void junction_populate(
@@ -126,6 +207,8 @@ void junction_populate(
     const JunctionComponent& junction
 )
 {
+    std::vector<entt::entity> segment;
+
     for (
         auto direction : Direction::EachDirectionIn { connectivity.directions }
     ) {
@@ -136,30 +219,33 @@ void junction_populate(
         )
             continue;
 
-        std::vector<entt::entity> segment {
-            get_segment_from(registry, junction_tile, direction)
-        };
-
-        if (segment.size() == 1)
+        segment.clear();
+        if (get_segment_from(registry, junction_tile, direction, segment) == 1)
             continue;
 
-        entt::entity segment_entity { registry.create() };
-
-        SegmentComponent& segment_component {
-            registry.emplace<SegmentComponent>(segment_entity, segment, direction)
-        };
+        segment_create(registry, segment.data(), segment.data() + segment.size(), direction);
+    }
+}
 
-        JunctionComponent& origin {
-            registry.get<JunctionComponent>(segment_component.origin)
-        };
+// Pack the members of the remaining segments together again, once those of
+// released segments take up most of the arena
+void arena_compact(entt::registry& registry, SegmentArena& arena)
+{
+    if (arena.released * 2 <= arena.members.size())
+        return;
 
-        JunctionComponent& termination {
-            registry.get<JunctionComponent>(segment_component.termination)
-        };
+    std::vector<entt::entity>& packed { arena.spare };
+    packed.clear();
+    packed.reserve(arena.members.size() - arena.released);
 
-        origin.connections[Direction::index_position(direction)] = segment_entity;
-        termination.connections[Direction::index_position(Direction::reverse(direction))] = segment_entity;
+    for (auto [entity, segment] : registry.view<SegmentComponent>().each()) {
+        SegmentArena::Range members { arena.of(segment.members) };
+        segment.members.offset = static_cast<uint32_t>(packed.size());
+        packed.insert(packed.end(), members.begin(), members.end());
     }
+
+    arena.members.swap(packed);
+    arena.released = 0;
 }
 
 void graph_release(entt::registry& registry)
@@ -174,14 +260,841 @@ void graph_release(entt::registry& registry)
     registry.clear<ConnectivityUpdateFlag>();
 }
 
-void graph_compute(entt::registry& registry)
+// Label the junctions and segments of each connected road network alike, by
+// union-find over the segments; a label is the index of one of its junctions
+void label_networks(entt::registry& registry, uint32_t junction_count)
+{
+    std::vector<uint32_t> parent(junction_count);
+    std::iota(parent.begin(), parent.end(), 0);
+
+    auto find { [&parent](uint32_t node) {
+        while (parent[node] != node) {
+            parent[node] = parent[parent[node]];
+            node = parent[node];
+        }
+        return node;
+    } };
+
+    auto junctions_view { registry.view<JunctionComponent>() };
+    for (auto [entity, junction] : junctions_view.each()) {
+        for (auto segment_entity : junction.connections) {
+            if (segment_entity == entt::null)
+                continue;
+
+            const SegmentComponent& segment { registry.get<const SegmentComponent>(segment_entity) };
+            entt::entity neighbour { segment.origin == entity ? segment.termination : segment.origin };
+            parent[find(junction.index)] = find(registry.get<const JunctionComponent>(neighbour).index);
+        }
+    }
+
+    for (auto [entity, junction] : junctions_view.each()) {
+        junction.network = find(junction.index);
+        for (auto segment_entity : junction.connections) {
+            if (segment_entity != entt::null)
+                registry.get<SegmentComponent>(segment_entity).network = junction.network;
+        }
+    }
+}
+
+// Segments walked by one slice of junctions, their tiles end to end
+struct SegmentWalks {
+    struct Walk {
+        Direction::TDirection direction;
+        size_t first;
+        size_t count;
+    };
+
+    std::vector<Walk> walks;
+    std::vector<entt::entity> tiles;
+};
+
+// Walk every segment from its junctions in parallel, then create them all
+// on this thread. Returns the number of junctions, one past the largest
+// network label.
+uint32_t graph_compute(entt::registry& registry)
 {
     auto junctions_view {
         registry.view<JunctionComponent, ConnectivityComponent>()
     };
+
+    std::vector<entt::entity> junctions;
+    uint32_t index { 0 };
     for (auto [entity, junction, connectivity] : junctions_view.each()) {
-        junction_populate(registry, entity, connectivity, junction);
+        junction.index = index++;
+        junctions.push_back(entity);
+    }
+
+    std::vector<SegmentWalks> walks(slice_count(junctions.size()));
+
+    const entt::registry& frozen_registry { registry };
+    run_slices(registry, junctions.size(), [&](size_t slice, size_t begin, size_t end) {
+        SegmentWalks& slice_walks { walks[slice] };
+
+        for (size_t position = begin; position < end; position++) {
+            entt::entity entity { junctions[position] };
+            const ConnectivityComponent& connectivity { frozen_registry.get<const ConnectivityComponent>(entity) };
+
+            for (auto direction : Direction::EachDirectionIn { connectivity.directions }) {
+                size_t first { slice_walks.tiles.size() };
+                size_t count { get_segment_from(frozen_registry, entity, direction, slice_walks.tiles) };
+
+                // Each segment is found from both ends; keep the walk from the
+                // junction a serial pass would have reached first
+                if (
+                    count == 1
+                    || frozen_registry.get<const JunctionComponent>(slice_walks.tiles.back()).index < position
+                ) {
+                    slice_walks.tiles.resize(first);
+                    continue;
+                }
+
+                slice_walks.walks.push_back({ direction, first, count });
+            }
+        }
+    });
+
+    // Grow the arena once for the whole graph
+    SegmentArena& arena { registry.ctx().get<SegmentArena>() };
+    size_t member_count { arena.members.size() };
+    for (const SegmentWalks& slice_walks : walks) {
+        member_count += slice_walks.tiles.size() - 2 * slice_walks.walks.size();
+    }
+    arena.members.reserve(member_count);
+
+    for (const SegmentWalks& slice_walks : walks) {
+        for (const SegmentWalks::Walk& walk : slice_walks.walks) {
+            const entt::entity* first { slice_walks.tiles.data() + walk.first };
+            segment_create(registry, first, first + walk.count, walk.direction);
+        }
+    }
+
+    label_networks(registry, index);
+    return index;
+}
+
+// The changed tiles and their neighbours; a tile's junction status depends
+// only on its own connectivity and that of the tiles beside it
+std::vector<entt::entity> affected_tiles(
+    const entt::registry& registry,
+    const std::vector<entt::entity>& changed_tiles
+)
+{
+    const Grid<entt::entity, TileMapProjection>& tilemap {
+        registry.ctx().get<const Grid<entt::entity, TileMapProjection>>()
+    };
+
+    std::vector<entt::entity> output;
+    for (auto tile : changed_tiles) {
+        const GridPositionComponent* grid_position { registry.try_get<const GridPositionComponent>(tile) };
+        if (!grid_position)
+            continue;
+
+        output.push_back(tile);
+        for (auto direction : Direction::EachDirectionIn { Direction::TDirection::ALL_CARDINAL_DIRECTIONS }) {
+            glm::ivec2 neighbour { grid_position->position + Direction::direction_vectors.at(direction) };
+            if (tilemap.position_is_valid(neighbour) && tilemap[neighbour] != entt::null)
+                output.push_back(tilemap[neighbour]);
+        }
+    }
+
+    std::sort(output.begin(), output.end());
+    output.erase(std::unique(output.begin(), output.end()), output.end());
+    return output;
+}
+
+// Detach the segment from its junctions and members ahead of its release,
+// noting the junctions left with an open connection
+void segment_release(
+    entt::registry& registry,
+    entt::entity segment_entity,
+    std::vector<entt::entity>& endpoints
+)
+{
+    const SegmentComponent& segment { registry.get<const SegmentComponent>(segment_entity) };
+
+    for (auto end : { segment.origin, segment.termination }) {
+        JunctionComponent* junction { registry.try_get<JunctionComponent>(end) };
+        if (!junction)
+            continue;
+
+        std::replace(
+            junction->connections.begin(),
+            junction->connections.end(),
+            segment_entity,
+            entt::entity { entt::null }
+        );
+        endpoints.push_back(end);
+    }
+
+    for (auto member : registry.ctx().get<const SegmentArena>().of(segment.members)) {
+        const SegmentMemberComponent* membership { registry.try_get<const SegmentMemberComponent>(member) };
+        if (membership && membership->segment == segment_entity)
+            registry.remove<SegmentMemberComponent>(member);
+    }
+
+    registry.emplace<EntityReleaseFlag>(segment_entity);
+}
+
+// Give every network holding one of the junctions a fresh label, flooding
+// out along its segments; networks the change didn't touch keep theirs
+void relabel_networks(
+    entt::registry& registry,
+    GraphStateComponent& graph_state,
+    const std::vector<entt::entity>& junctions
+)
+{
+    const uint32_t first_label { graph_state.next_network };
+    std::vector<entt::entity> frontier;
+
+    for (auto seed : junctions) {
+        JunctionComponent* seed_junction { registry.try_get<JunctionComponent>(seed) };
+        if (!seed_junction || seed_junction->network >= first_label)
+            continue;
+
+        const uint32_t label { graph_state.next_network++ };
+        seed_junction->network = label;
+        frontier.push_back(seed);
+
+        while (!frontier.empty()) {
+            entt::entity entity { frontier.back() };
+            frontier.pop_back();
+
+            for (auto segment_entity : registry.get<const JunctionComponent>(entity).connections) {
+                if (segment_entity == entt::null)
+                    continue;
+
+                SegmentComponent& segment { registry.get<SegmentComponent>(segment_entity) };
+                segment.network = label;
+
+                entt::entity neighbour { segment.origin == entity ? segment.termination : segment.origin };
+                JunctionComponent& neighbour_junction { registry.get<JunctionComponent>(neighbour) };
+                if (neighbour_junction.network != label) {
+                    neighbour_junction.network = label;
+                    frontier.push_back(neighbour);
+                }
+            }
+        }
+    }
+}
+
+// Rebuild only the part of the graph the changed tiles can affect: retag
+// the tiles around them, and walk again every segment passing through or
+// ending among those tiles. The rest of the graph is left as it was.
+void graph_update_local(entt::registry& registry, GraphStateComponent& graph_state)
+{
+    std::vector<entt::entity> region { affected_tiles(registry, graph_state.changed_tiles) };
+
+    std::vector<entt::entity> segments;
+    for (auto tile : region) {
+        if (const JunctionComponent* junction { registry.try_get<const JunctionComponent>(tile) }) {
+            for (auto segment_entity : junction->connections) {
+                if (segment_entity != entt::null)
+                    segments.push_back(segment_entity);
+            }
+        }
+
+        if (const SegmentMemberComponent* membership { registry.try_get<const SegmentMemberComponent>(tile) })
+            segments.push_back(membership->segment);
+    }
+
+    std::sort(segments.begin(), segments.end());
+    segments.erase(std::unique(segments.begin(), segments.end()), segments.end());
+
+    std::vector<entt::entity> endpoints;
+    for (auto segment_entity : segments) {
+        segment_release(registry, segment_entity, endpoints);
+    }
+
+    const ConnectivityGrid& connectivity { registry.ctx().get<const ConnectivityGrid>() };
+    for (auto tile : region) {
+        registry.remove<JunctionComponent>(tile);
+
+        if (tags_as_junction(connectivity, registry.get<const GridPositionComponent>(tile).position)) {
+            registry.emplace<JunctionComponent>(tile);
+            endpoints.push_back(tile);
+        }
+    }
+
+    for (auto tile : endpoints) {
+        JunctionComponent* junction { registry.try_get<JunctionComponent>(tile) };
+        if (junction)
+            junction_populate(registry, tile, registry.get<const ConnectivityComponent>(tile), *junction);
+    }
+
+    registry.clear<ConnectivityUpdateFlag>();
+
+    uint32_t index { 0 };
+    for (auto [entity, junction] : registry.view<JunctionComponent>().each()) {
+        junction.index = index++;
+    }
+
+    relabel_networks(registry, graph_state, endpoints);
+}
+
+/*
+    A full rebuild carried out over several frames, for changes too large to
+    patch locally. The new junctions and segments are worked out from a copy
+    of the tiles' connectivity taken when the rebuild began, a slice per frame
+    within GraphStateComponent::rebuild_budget_millis, while the registry
+    keeps the previous graph for pathfinding. Once everything is walked the
+    new graph replaces the old within a single frame.
+
+    Tiles changed meanwhile wait for the rebuild to finish, and are then
+    flagged again to be patched in like any other change.
+*/
+struct GraphRebuild {
+    enum class Phase {
+        IDLE,
+        TAGGING,
+        WALKING
+    };
+
+    Phase phase { Phase::IDLE };
+    ConnectivityGrid connectivity;
+    // Tilemap indices of the junctions, in tile order; a bit per tile besides
+    std::vector<uint32_t> junctions;
+    std::vector<uint64_t> junction_bits;
+    size_t next_word { 0 };
+    size_t next_junction { 0 };
+    SegmentWalks walks;
+    // Every tile changed since the live graph was built, up to the copy
+    std::vector<entt::entity> changed_tiles;
+    // Tiles changed since the copy was taken
+    std::vector<entt::entity> later_tiles;
+    // Frames spent so far, checked against frame_limit
+    size_t frames { 0 };
+};
+
+// Work between clock checks while rebuilding over several frames
+constexpr size_t REBUILD_STEP_SIZE { 64 };
+
+// Every frame does at least a step of the work fixed when the rebuild
+// began, so it finishes within this many whatever else changes meanwhile
+size_t frame_limit(const GraphRebuild& rebuild)
+{
+    auto steps { [](size_t items) { return (items + REBUILD_STEP_SIZE - 1) / REBUILD_STEP_SIZE; } };
+    return steps(rebuild.connectivity.words.size()) + steps(rebuild.junctions.size()) + 1;
+}
+
+void rebuild_begin(entt::registry& registry, GraphRebuild& rebuild)
+{
+    const Grid<entt::entity, TileMapProjection>& tilemap {
+        registry.ctx().get<const Grid<entt::entity, TileMapProjection>>()
+    };
+
+    rebuild.connectivity.resize(tilemap.grid_dimensions);
+    auto connectivity_view { registry.view<const ConnectivityComponent, const GridPositionComponent>() };
+    for (auto [entity, connectivity, grid_position] : connectivity_view.each()) {
+        rebuild.connectivity.set(grid_position.position, connectivity.directions);
+    }
+
+    rebuild.phase = GraphRebuild::Phase::TAGGING;
+    rebuild.junctions.clear();
+    rebuild.junction_bits.assign((tilemap.cells.size() + 63) / 64, 0);
+    rebuild.next_word = 0;
+    rebuild.next_junction = 0;
+    rebuild.frames = 0;
+    rebuild.walks.walks.clear();
+    rebuild.walks.tiles.clear();
+}
+
+// Carry the rebuild on until it is finished or the budget is spent, with no
+// budget finishing it outright; returns whether it has finished
+bool rebuild_continue(entt::registry& registry, GraphRebuild& rebuild, float& progress, float budget_millis)
+{
+    const Grid<entt::entity, TileMapProjection>& tilemap {
+        registry.ctx().get<const Grid<entt::entity, TileMapProjection>>()
+    };
+    const ConnectivityGrid& connectivity { rebuild.connectivity };
+
+    const auto start { std::chrono::steady_clock::now() };
+    auto out_of_time { [&]() {
+        const std::chrono::duration<float, std::milli> elapsed { std::chrono::steady_clock::now() - start };
+        return budget_millis > 0.f && elapsed.count() >= budget_millis;
+    } };
+
+    auto tile_index { [&](glm::ivec2 position) {
+        return static_cast<uint32_t>(position.y * tilemap.grid_dimensions.x + position.x);
+    } };
+
+    auto is_junction { [&](glm::ivec2 position) {
+        uint32_t tile { tile_index(position) };
+        return (rebuild.junction_bits[tile / 64] >> (tile % 64)) & 1;
+    } };
+
+    while (rebuild.phase == GraphRebuild::Phase::TAGGING) {
+        size_t end { std::min(connectivity.words.size(), rebuild.next_word + REBUILD_STEP_SIZE) };
+
+        for (size_t word = rebuild.next_word; word < end; word++) {
+            uint64_t junction_bits {
+                ConnectivityGrid::junction_nibbles(connectivity.words[word])
+                | ConnectivityGrid::junction_nibbles(connectivity.resolved(word))
+            };
+
+            glm::ivec2 first_tile {
+                int(word % connectivity.row_words) * ConnectivityGrid::TILES_PER_WORD,
+                int(word / connectivity.row_words)
+            };
+
+            while (junction_bits) {
+                uint32_t tile { tile_index(first_tile + glm::ivec2 { __builtin_ctzll(junction_bits) / 4, 0 }) };
+                rebuild.junctions.push_back(tile);
+                rebuild.junction_bits[tile / 64] |= uint64_t { 1 } << (tile % 64);
+                junction_bits &= junction_bits - 1;
+            }
+        }
+
+        rebuild.next_word = end;
+        progress = 0.5f * rebuild.next_word / std::max<size_t>(connectivity.words.size(), 1);
+
+        if (rebuild.next_word == connectivity.words.size())
+            rebuild.phase = GraphRebuild::Phase::WALKING;
+        else if (out_of_time())
+            return false;
+    }
+
+    SegmentWalks& walks { rebuild.walks };
+    while (rebuild.next_junction < rebuild.junctions.size()) {
+        size_t end { std::min(rebuild.junctions.size(), rebuild.next_junction + REBUILD_STEP_SIZE) };
+
+        for (size_t junction = rebuild.next_junction; junction < end; junction++) {
+            uint32_t tile { rebuild.junctions[junction] };
+            glm::ivec2 position { int(tile) % tilemap.grid_dimensions.x, int(tile) / tilemap.grid_dimensions.x };
+
+            for (auto direction : Direction::EachDirectionIn { connectivity.at(position) }) {
+                size_t first { walks.tiles.size() };
+                size_t count { walk_segment(tilemap, connectivity, is_junction, position, direction, walks.tiles) };
+
+                // Each segment is found from both ends; keep one walk of the two
+                glm::ivec2 end_position { position + Direction::direction_vectors.at(direction) * int(count - 1) };
+                if (count == 1 || tile_index(end_position) < tile) {
+                    walks.tiles.resize(first);
+                    continue;
+                }
+
+                walks.walks.push_back({ direction, first, count });
+            }
+        }
+
+        rebuild.next_junction = end;
+        progress = 0.5f + 0.5f * rebuild.next_junction / rebuild.junctions.size();
+
+        if (rebuild.next_junction < rebuild.junctions.size() && out_of_time())
+            return false;
+    }
+
+    return true;
+}
+
+// Replace the live graph with the rebuilt one. Returns the number of
+// junctions, one past the largest network label.
+uint32_t rebuild_finish(entt::registry& registry, GraphRebuild& rebuild)
+{
+    const Grid<entt::entity, TileMapProjection>& tilemap {
+        registry.ctx().get<const Grid<entt::entity, TileMapProjection>>()
+    };
+
+    graph_release(registry);
+    std::swap(registry.ctx().get<ConnectivityGrid>(), rebuild.connectivity);
+
+    for (auto tile : rebuild.junctions) {
+        registry.emplace<JunctionComponent>(tilemap.cells[tile]);
+    }
+
+    // Index the junctions and orient the segments as graph_compute would
+    uint32_t index { 0 };
+    for (auto [entity, junction] : registry.view<JunctionComponent>().each()) {
+        junction.index = index++;
+    }
+
+    SegmentArena& arena { registry.ctx().get<SegmentArena>() };
+    arena.members.reserve(arena.members.size() + rebuild.walks.tiles.size() - 2 * rebuild.walks.walks.size());
+
+    for (const SegmentWalks::Walk& walk : rebuild.walks.walks) {
+        entt::entity* first { rebuild.walks.tiles.data() + walk.first };
+        entt::entity* last { first + walk.count };
+        Direction::TDirection direction { walk.direction };
+
+        if (registry.get<const JunctionComponent>(*(last - 1)).index < registry.get<const JunctionComponent>(*first).index) {
+            std::reverse(first, last);
+            direction = Direction::reverse(direction);
+        }
+
+        segment_create(registry, first, last, direction);
+    }
+
+    label_networks(registry, index);
+
+    rebuild.phase = GraphRebuild::Phase::IDLE;
+    return index;
+}
+
+// Copy the junction graph into the context as compressed sparse rows
+void graph_snapshot(entt::registry& registry, uint64_t generation)
+{
+    RoadGraph& graph { registry.ctx().emplace<RoadGraph>() };
+    graph.clear();
+    graph.generation = generation;
+
+    auto junctions_view { registry.view<const JunctionComponent>() };
+    graph.junctions.resize(junctions_view.size(), entt::null);
+    for (auto [entity, junction] : junctions_view.each()) {
+        graph.junctions[junction.index] = entity;
+    }
+
+    for (auto entity : graph.junctions) {
+        const JunctionComponent& junction { registry.get<const JunctionComponent>(entity) };
+        graph.positions.push_back(registry.get<const GridPositionComponent>(entity).position);
+        graph.networks.push_back(junction.network);
+        graph.offsets.push_back(static_cast<uint32_t>(graph.edge_count()));
+
+        for (auto direction : Direction::EachDirectionIn { Direction::TDirection::ALL_CARDINAL_DIRECTIONS }) {
+            entt::entity segment_entity { junction.connections[Direction::index_position(direction)] };
+            if (segment_entity == entt::null)
+                continue;
+
+            const SegmentComponent& segment { registry.get<const SegmentComponent>(segment_entity) };
+            entt::entity neighbour { segment.origin == entity ? segment.termination : segment.origin };
+
+            graph.targets.push_back(registry.get<const JunctionComponent>(neighbour).index);
+            graph.costs.push_back(segment.cost);
+            graph.directions.push_back(direction);
+            graph.segments.push_back(segment_entity);
+        }
+    }
+    graph.offsets.push_back(static_cast<uint32_t>(graph.edge_count()));
+}
+
+// The snapshot GraphSystem took before its latest, kept to tell what changed
+struct GraphHistory {
+    RoadGraph previous;
+};
+
+// Work out what changed between two snapshots, comparing junctions and
+// segments by entity
+void graph_changes(const RoadGraph& previous, const RoadGraph& current, GraphChanges& changes)
+{
+    changes.clear();
+
+    // Each junction's position in its snapshot, and each segment's network
+    auto junctions_of { [](const RoadGraph& graph) {
+        std::vector<std::pair<entt::entity, uint32_t>> junctions;
+        junctions.reserve(graph.junction_count());
+        for (uint32_t index = 0; index < graph.junction_count(); index++) {
+            junctions.emplace_back(graph.junctions[index], index);
+        }
+        std::sort(junctions.begin(), junctions.end());
+        return junctions;
+    } };
+
+    auto segments_of { [](const RoadGraph& graph) {
+        std::vector<std::pair<entt::entity, uint32_t>> segments;
+        segments.reserve(graph.edge_count());
+        for (uint32_t index = 0; index < graph.junction_count(); index++) {
+            for (uint32_t edge = graph.offsets[index]; edge < graph.offsets[index + 1]; edge++) {
+                segments.emplace_back(graph.segments[edge], graph.networks[index]);
+            }
+        }
+        std::sort(segments.begin(), segments.end());
+        segments.erase(std::unique(segments.begin(), segments.end()), segments.end());
+        return segments;
+    } };
+
+    // Walk both sorted lists together, sorting entities by which hold them
+    auto compare { [](const auto& before, const auto& after, auto& added, auto& removed, auto&& modified) {
+        auto old_it { before.begin() };
+        auto new_it { after.begin() };
+        while (old_it != before.end() || new_it != after.end()) {
+            if (new_it == after.end() || (old_it != before.end() && old_it->first < new_it->first)) {
+                removed.push_back((old_it++)->first);
+            } else if (old_it == before.end() || new_it->first < old_it->first) {
+                added.push_back((new_it++)->first);
+            } else {
+                modified(*old_it++, *new_it++);
+            }
+        }
+    } };
+
+    compare(
+        junctions_of(previous),
+        junctions_of(current),
+        changes.added_junctions,
+        changes.removed_junctions,
+        [&](std::pair<entt::entity, uint32_t> before, std::pair<entt::entity, uint32_t> after) {
+            auto edges { [](const RoadGraph& graph, uint32_t index) {
+                return std::make_pair(
+                    graph.segments.begin() + graph.offsets[index],
+                    graph.segments.begin() + graph.offsets[index + 1]
+                );
+            } };
+
+            auto [old_first, old_last] { edges(previous, before.second) };
+            auto [new_first, new_last] { edges(current, after.second) };
+            if (
+                previous.networks[before.second] != current.networks[after.second]
+                || !std::equal(old_first, old_last, new_first, new_last)
+            )
+                changes.modified_junctions.push_back(after.first);
+        }
+    );
+
+    compare(
+        segments_of(previous),
+        segments_of(current),
+        changes.added_segments,
+        changes.removed_segments,
+        [&](std::pair<entt::entity, uint32_t> before, std::pair<entt::entity, uint32_t> after) {
+            if (before.second != after.second)
+                changes.modified_segments.push_back(after.first);
+        }
+    );
+}
+
+// FNV-1a over the grid's dimensions and packed connectivity
+uint64_t connectivity_checksum(const ConnectivityGrid& connectivity)
+{
+    uint64_t hash { 0xcbf29ce484222325 };
+    auto mix { [&hash](uint64_t value) {
+        for (int byte = 0; byte < 8; byte++) {
+            hash ^= (value >> (8 * byte)) & 0xFF;
+            hash *= 0x100000001b3;
+        }
+    } };
+
+    mix((uint64_t(uint32_t(connectivity.dimensions.x)) << 32) | uint32_t(connectivity.dimensions.y));
+    for (auto word : connectivity.words) {
+        mix(word);
+    }
+
+    return hash;
+}
+
+// Every junction index used exactly once, as the snapshot relies on
+bool junctions_indexed(const entt::registry& registry)
+{
+    auto junctions_view { registry.view<const JunctionComponent>() };
+    std::vector<bool> indexed(junctions_view.size(), false);
+
+    for (auto [entity, junction] : junctions_view.each()) {
+        if (junction.index >= indexed.size() || indexed[junction.index])
+            return false;
+        indexed[junction.index] = true;
+    }
+
+    return true;
+}
+
+// Every loaded segment joins two junctions over a run of existing tiles, at
+// the cost of walking it; saves from when segments charged a crossing don't
+bool segments_intact(const entt::registry& registry)
+{
+    const SegmentArena& arena { registry.ctx().get<const SegmentArena>() };
+    for (auto [entity, segment] : registry.view<const SegmentComponent>().each()) {
+        if (
+            !registry.valid(segment.origin) || !registry.all_of<JunctionComponent>(segment.origin)
+            || !registry.valid(segment.termination) || !registry.all_of<JunctionComponent>(segment.termination)
+            || !arena.holds(segment.members)
+            || segment.cost != static_cast<int>(segment.members.size()) + 1
+        )
+            return false;
+
+        for (auto member : arena.of(segment.members)) {
+            if (!registry.valid(member))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// Every junction's connections are loaded segments that end on it, and every
+// segment is connected at both ends
+bool junctions_connected(const entt::registry& registry)
+{
+    for (auto [entity, junction] : registry.view<const JunctionComponent>().each()) {
+        for (auto connection : junction.connections) {
+            if (connection == entt::null)
+                continue;
+
+            const SegmentComponent* segment {
+                registry.valid(connection) ? registry.try_get<const SegmentComponent>(connection) : nullptr
+            };
+            if (!segment || (segment->origin != entity && segment->termination != entity))
+                return false;
+        }
+    }
+
+    // Run after segments_intact, so both ends are junctions
+    for (auto [entity, segment] : registry.view<const SegmentComponent>().each()) {
+        const uint8_t direction { Direction::to_underlying(segment.direction) };
+        // A single cardinal direction
+        if (
+            direction == 0
+            || (direction & (direction - 1))
+            || direction > Direction::to_underlying(Direction::TDirection::ALL_CARDINAL_DIRECTIONS)
+        )
+            return false;
+
+        const JunctionComponent& origin { registry.get<const JunctionComponent>(segment.origin) };
+        const JunctionComponent& termination { registry.get<const JunctionComponent>(segment.termination) };
+        if (
+            origin.connections[Direction::index_position(segment.direction)] != entity
+            || termination.connections[Direction::index_position(Direction::reverse(segment.direction))] != entity
+        )
+            return false;
+    }
+
+    return true;
+}
+
+// Work out the landmarks and contraction hierarchy for the current graph
+void graph_refresh(entt::registry& registry, GraphStateComponent& graph_state)
+{
+    Pathfinding::prepare_landmarks(registry);
+    Hierarchy::build(registry);
+    graph_state.hierarchy_stale = false;
+}
+
+// Make a new graph generation out of the changed components, and bring
+// everything derived from the graph up to date with it. After a local patch
+// the landmarks and hierarchy are dropped instead, and left to GraphSystem to
+// rebuild once edits stop; searches fall back to plain A* until then.
+void graph_publish(entt::registry& registry, GraphStateComponent& graph_state, bool patched)
+{
+    graph_state.generation++;
+
+    GraphHistory& history { registry.ctx().emplace<GraphHistory>() };
+    std::swap(history.previous, registry.ctx().emplace<RoadGraph>());
+    graph_snapshot(registry, graph_state.generation);
+    graph_changes(history.previous, registry.ctx().get<const RoadGraph>(), graph_state.changes);
+
+    Pathfinding::prepare(registry);
+
+    graph_state.settled_frames = 0;
+    if (patched) {
+        registry.ctx().erase<ContractionHierarchy>();
+        graph_state.hierarchy_stale = true;
+    } else {
+        graph_refresh(registry, graph_state);
+    }
+}
+
+// Compare the graph with what a full rebuild would make of the same tiles,
+// logging each difference; used to check the local rebuild
+bool graph_check(const entt::registry& registry)
+{
+    bool matches { true };
+    auto report { [&registry, &matches](entt::entity tile, const char* problem) {
+        glm::ivec2 position { registry.get<const GridPositionComponent>(tile).position };
+        spdlog::error("Graph check: {} at ({}, {})", problem, position.x, position.y);
+        matches = false;
+    } };
+
+    const ConnectivityGrid& connectivity_grid { registry.ctx().get<const ConnectivityGrid>() };
+    auto connectivity_view { registry.view<const ConnectivityComponent, const GridPositionComponent>() };
+    for (auto [entity, connectivity, grid_position] : connectivity_view.each()) {
+        if (connectivity_grid.at(grid_position.position) != connectivity.directions)
+            report(entity, "connectivity grid out of date");
+
+        if (tags_as_junction(connectivity_grid, grid_position.position) != registry.all_of<JunctionComponent>(entity))
+            report(entity, "junction tagged wrongly");
+    }
+
+    // Segments are walked between the tagged junctions, so can't be checked without them
+    if (!matches)
+        return false;
+
+    const SegmentArena& arena { registry.ctx().get<const SegmentArena>() };
+    auto junctions_view { registry.view<const JunctionComponent>() };
+    std::vector<uint32_t> parent(junctions_view.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    std::vector<bool> indexed(junctions_view.size(), false);
+
+    auto find { [&parent](uint32_t node) {
+        while (parent[node] != node) {
+            parent[node] = parent[parent[node]];
+            node = parent[node];
+        }
+        return node;
+    } };
+
+    for (auto [entity, junction] : junctions_view.each()) {
+        if (junction.index >= indexed.size() || indexed[junction.index]) {
+            report(entity, "junction index not dense");
+            return false;
+        }
+        indexed[junction.index] = true;
+    }
+
+    size_t segment_count { 0 };
+    for (auto [entity, junction] : junctions_view.each()) {
+        const ConnectivityComponent& connectivity { registry.get<const ConnectivityComponent>(entity) };
+
+        for (auto direction : Direction::EachDirectionIn { Direction::TDirection::ALL_CARDINAL_DIRECTIONS }) {
+            entt::entity segment_entity { junction.connections[Direction::index_position(direction)] };
+
+            std::vector<entt::entity> expected;
+            if (Direction::any(connectivity.directions & direction))
+                get_segment_from(registry, entity, direction, expected);
+
+            if (expected.size() < 2) {
+                if (segment_entity != entt::null)
+                    report(entity, "segment where no road leads");
+                continue;
+            }
+
+            if (segment_entity == entt::null || registry.all_of<EntityReleaseFlag>(segment_entity)) {
+                report(entity, "segment missing");
+                continue;
+            }
+
+            const SegmentComponent& segment { registry.get<const SegmentComponent>(segment_entity) };
+            SegmentArena::Range members { arena.of(segment.members) };
+            std::vector<entt::entity> walked { segment.origin };
+            walked.insert(walked.end(), members.begin(), members.end());
+            walked.push_back(segment.termination);
+            if (segment.origin != entity)
+                std::reverse(walked.begin(), walked.end());
+
+            if (walked != expected || segment.cost != static_cast<int>(expected.size()) - 1)
+                report(entity, "segment differs from a fresh walk");
+
+            for (auto member : members) {
+                const SegmentMemberComponent* membership { registry.try_get<const SegmentMemberComponent>(member) };
+                if (!membership || membership->segment != segment_entity)
+                    report(member, "tile not a member of its segment");
+            }
+
+            if (segment.network != junction.network)
+                report(entity, "segment labelled with another network");
+
+            entt::entity neighbour { segment.origin == entity ? segment.termination : segment.origin };
+            parent[find(junction.index)] = find(registry.get<const JunctionComponent>(neighbour).index);
+
+            if (segment.origin == entity)
+                segment_count++;
+        }
     }
+
+    auto segments_view { registry.view<const SegmentComponent>(entt::exclude<EntityReleaseFlag>) };
+    size_t live_segments { static_cast<size_t>(std::distance(segments_view.begin(), segments_view.end())) };
+    if (live_segments != segment_count) {
+        spdlog::error("Graph check: {} segments, expected {}", live_segments, segment_count);
+        matches = false;
+    }
+
+    // Labels and networks must correspond one to one
+    std::unordered_map<uint32_t, uint32_t> network_of_root;
+    std::unordered_map<uint32_t, uint32_t> root_of_network;
+    for (auto [entity, junction] : junctions_view.each()) {
+        uint32_t root { find(junction.index) };
+        auto [network, network_inserted] { network_of_root.try_emplace(root, junction.network) };
+        auto [labelled, label_inserted] { root_of_network.try_emplace(junction.network, root) };
+        if (network->second != junction.network || labelled->second != root)
+            report(entity, "junction labelled with another network");
+    }
+
+    return matches;
 }
 }
 
@@ -189,20 +1102,141 @@ namespace GraphSystem {
 
 void update(entt::registry& registry)
 {
+    GraphRebuild& rebuild { registry.ctx().emplace<GraphRebuild>() };
+
     auto change_view { registry.view<ConnectivityUpdateFlag>() };
-    if (change_view.begin() == change_view.end())
+    const bool changed { change_view.begin() != change_view.end() };
+    if (!changed && rebuild.phase == GraphRebuild::Phase::IDLE) {
+        GraphStateComponent* graph_state { registry.ctx().find<GraphStateComponent>() };
+        if (
+            graph_state
+            && graph_state->hierarchy_stale
+            && ++graph_state->settled_frames >= Constants::GRAPH_SETTLE_FRAMES
+        )
+            graph_refresh(registry, *graph_state);
         return;
+    }
 
-    graph_release(registry);
-    tag_junctions(registry);
-    graph_compute(registry);
+    GraphStateComponent& graph_state { registry.ctx().emplace<GraphStateComponent>() };
+
+    const Grid<entt::entity, TileMapProjection>& tilemap {
+        registry.ctx().get<const Grid<entt::entity, TileMapProjection>>()
+    };
+    ConnectivityGrid& connectivity { registry.ctx().emplace<ConnectivityGrid>() };
+
+    SegmentArena& arena { registry.ctx().emplace<SegmentArena>() };
+    auto junctions_view { registry.view<const JunctionComponent>() };
+    const bool has_graph { junctions_view.begin() != junctions_view.end() };
+
+    // Large changes to an existing graph are rebuilt over several frames;
+    // changes made meanwhile are held back until the rebuild is done
+    bool rebuild_all { false };
+    bool patched { false };
+    const bool sliced {
+        changed
+        && has_graph
+        && graph_state.rebuild_budget_millis > 0.f
+        && connectivity.dimensions == tilemap.grid_dimensions
+    };
+    if (sliced && rebuild.phase != GraphRebuild::Phase::IDLE) {
+        rebuild.later_tiles.insert(rebuild.later_tiles.end(), change_view.begin(), change_view.end());
+        registry.clear<ConnectivityUpdateFlag>();
+    } else if (sliced && size_t(std::distance(change_view.begin(), change_view.end())) > Constants::LOCAL_REBUILD_MAX_TILES) {
+        rebuild.changed_tiles.assign(change_view.begin(), change_view.end());
+        registry.clear<ConnectivityUpdateFlag>();
+        rebuild_begin(registry, rebuild);
+    } else if (changed && rebuild.phase != GraphRebuild::Phase::IDLE) {
+        // Overtaken by a change to make at once; its tiles go into a full rebuild
+        rebuild.changed_tiles.insert(rebuild.changed_tiles.end(), rebuild.later_tiles.begin(), rebuild.later_tiles.end());
+        rebuild.later_tiles.clear();
+        rebuild.phase = GraphRebuild::Phase::IDLE;
+        graph_state.rebuild_progress = 1.f;
+        rebuild_all = true;
+    }
+
+    if (rebuild.phase != GraphRebuild::Phase::IDLE) {
+        rebuild.frames++;
+        if (!rebuild_continue(registry, rebuild, graph_state.rebuild_progress, graph_state.rebuild_budget_millis))
+            return;
+
+        graph_state.changed_tiles.swap(rebuild.changed_tiles);
+        arena_compact(registry, arena);
+        if (graph_state.check_rebuilds && rebuild.frames > frame_limit(rebuild)) {
+            spdlog::warn("Road graph rebuild took {} frames, over its limit of {}", rebuild.frames, frame_limit(rebuild));
+            graph_state.check_failures++;
+        }
+
+        graph_state.next_network = rebuild_finish(registry, rebuild);
+        graph_state.rebuild_progress = 1.f;
+
+        // The rebuild worked from the tiles as they were when it began
+        for (auto tile : rebuild.later_tiles) {
+            if (registry.valid(tile))
+                registry.emplace_or_replace<ConnectivityUpdateFlag>(tile);
+        }
+        rebuild.later_tiles.clear();
+    } else {
+        graph_state.changed_tiles.assign(change_view.begin(), change_view.end());
+        if (rebuild_all)
+            graph_state.changed_tiles.insert(graph_state.changed_tiles.end(), rebuild.changed_tiles.begin(), rebuild.changed_tiles.end());
+
+        auto segments_view { registry.view<const SegmentComponent>() };
+        if (segments_view.begin() == segments_view.end())
+            arena.clear();
+        else
+            arena_compact(registry, arena);
+
+        if (
+            rebuild_all
+            || !has_graph
+            || graph_state.changed_tiles.size() > Constants::LOCAL_REBUILD_MAX_TILES
+            || connectivity.dimensions != tilemap.grid_dimensions
+        ) {
+            connectivity.resize(tilemap.grid_dimensions);
+            auto connectivity_view { registry.view<const ConnectivityComponent, const GridPositionComponent>() };
+            for (auto [entity, tile_connectivity, grid_position] : connectivity_view.each()) {
+                connectivity.set(grid_position.position, tile_connectivity.directions);
+            }
+
+            graph_release(registry);
+            tag_junctions(registry);
+            graph_state.next_network = graph_compute(registry);
+        } else {
+            for (auto tile : graph_state.changed_tiles) {
+                const GridPositionComponent* grid_position { registry.try_get<const GridPositionComponent>(tile) };
+                if (!grid_position)
+                    continue;
+
+                const ConnectivityComponent* tile_connectivity { registry.try_get<const ConnectivityComponent>(tile) };
+                connectivity.set(
+                    grid_position->position,
+                    tile_connectivity ? tile_connectivity->directions : Direction::TDirection::NO_DIRECTION
+                );
+            }
+
+            graph_update_local(registry, graph_state);
+            patched = true;
+
+            if (graph_state.check_rebuilds && !graph_check(registry))
+                graph_state.check_failures++;
+        }
+    }
+
+    graph_publish(registry, graph_state, patched);
 }
 
 void create(entt::registry& registry, entt::entity entity)
 {
     const SegmentComponent& segment { registry.get<const SegmentComponent>(entity) };
-    for (auto member : segment.entities) {
-        registry.emplace_or_replace<SegmentMemberComponent>(member, entity);
+    const SegmentArena& arena { registry.ctx().get<const SegmentArena>() };
+
+    // A loaded run that doesn't fit is caught by restore, which rebuilds
+    if (!arena.holds(segment.members))
+        return;
+
+    for (auto member : arena.of(segment.members)) {
+        if (registry.valid(member))
+            registry.emplace_or_replace<SegmentMemberComponent>(member, entity);
     }
 }
 
@@ -212,8 +1246,67 @@ void remove(entt::registry& registry, entt::entity entity)
         return;
 
     const SegmentComponent& segment { registry.get<const SegmentComponent>(entity) };
-    for (auto member : segment.entities) {
-        registry.remove<SegmentMemberComponent>(member);
+    SegmentArena& arena { registry.ctx().get<SegmentArena>() };
+    arena.released += segment.members.size();
+
+    for (auto member : arena.of(segment.members)) {
+        // Released a frame after the rebuild; members may have a new segment
+        const SegmentMemberComponent* membership { registry.try_get<const SegmentMemberComponent>(member) };
+        if (membership && membership->segment == entity)
+            registry.remove<SegmentMemberComponent>(member);
     }
 }
-}
\ No newline at end of file
+
+uint64_t checksum(const entt::registry& registry)
+{
+    const ConnectivityGrid* connectivity { registry.ctx().find<const ConnectivityGrid>() };
+    return connectivity_checksum(connectivity ? *connectivity : ConnectivityGrid {});
+}
+
+void restore(entt::registry& registry, uint64_t saved_checksum)
+{
+    const Grid<entt::entity, TileMapProjection>& tilemap {
+        registry.ctx().get<const Grid<entt::entity, TileMapProjection>>()
+    };
+
+    ConnectivityGrid& connectivity { registry.ctx().emplace<ConnectivityGrid>() };
+    connectivity.resize(tilemap.grid_dimensions);
+    auto connectivity_view { registry.view<const ConnectivityComponent, const GridPositionComponent>() };
+    for (auto [entity, tile_connectivity, grid_position] : connectivity_view.each()) {
+        connectivity.set(grid_position.position, tile_connectivity.directions);
+    }
+
+    if (
+        connectivity_checksum(connectivity) != saved_checksum
+        || !junctions_indexed(registry)
+        || !segments_intact(registry)
+        || !junctions_connected(registry)
+    ) {
+        spdlog::info("Saved road graph doesn't match the tiles; rebuilding it");
+
+        // The loaded segments are released without going through their runs,
+        // which may not fit the arena; without junctions, the whole graph is
+        // rebuilt
+        for (auto [entity, segment] : registry.view<SegmentComponent>().each()) {
+            segment.members = {};
+        }
+        registry.clear<SegmentMemberComponent>();
+        registry.ctx().get<SegmentArena>().clear();
+        registry.clear<JunctionComponent>();
+        update(registry);
+        return;
+    }
+
+    GraphStateComponent& graph_state { registry.ctx().emplace<GraphStateComponent>() };
+    auto change_view { registry.view<ConnectivityUpdateFlag>() };
+    graph_state.changed_tiles.assign(change_view.begin(), change_view.end());
+    registry.clear<ConnectivityUpdateFlag>();
+
+    graph_state.next_network = 0;
+    for (auto [entity, junction] : registry.view<const JunctionComponent>().each()) {
+        graph_state.next_network = std::max(graph_state.next_network, junction.network + 1);
+    }
+
+    graph_publish(registry, graph_state, false);
+}
+}
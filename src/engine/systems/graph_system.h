@@ -1,12 +1,21 @@
 #ifndef GRAPHSYSTEM_H
 #define GRAPHSYSTEM_H
 
+#include <cstdint>
 #include <entt/entt.hpp>
 
 namespace GraphSystem {
 void create(entt::registry& registry, entt::entity entity);
 void update(entt::registry& registry);
 void remove(entt::registry& registry, entt::entity entity);
+
+// Fingerprint of the tile connectivity the road graph was built from, saved
+// with the graph so that loading can tell whether it still applies
+uint64_t checksum(const entt::registry& registry);
+
+// Take up a loaded graph if the tiles match the checksum it was saved with,
+// or rebuild it from the tiles if not
+void restore(entt::registry& registry, uint64_t saved_checksum);
 };
 
 #endif
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <components/velocity_component.h>
 #include <directions.h>
 #include <entt/entt.hpp>
+#include <pathfinding.h>
 #include <spdlog/spdlog.h>
 #include <spritesheet.h>
 #include <systems/movement_system.h>
@@ -19,54 +20,55 @@ void advance(
     PathComponent& path
 )
 {
-    const PathSegment& current_segment { path.path.at(path.current) };
-    const glm::vec2 remaining { glm::vec2 { current_segment.end } - transform.position };
+    const glm::vec2 remaining { glm::vec2 { path.segment.end } - transform.position };
     const float dist_to_target = glm::length(remaining);
-    const glm::vec2 movement_vector {
-        Direction::isometric_direction_vectors.at(current_segment.direction)
-    };
     glm::vec2 movement {};
+    bool segment_done { false };
 
     if (budget > dist_to_target) {
         // If we can afford to, move to the end of the current segment
         movement = remaining;
         budget -= dist_to_target;
-        path.current++;
+        segment_done = true;
     } else {
-        // Otherwise, move as far as we can afford along the current segment
-        movement = budget * glm::normalize(movement_vector);
+        // Otherwise, move as far as we can afford along the current segment;
+        // towards its end, as repaired paths can join off the direction vector
+        movement = budget * glm::normalize(remaining);
         budget = 0;
     }
 
     // Apply the movement to the transform
     registry.patch<TransformComponent>(
         entity,
-        [&current_segment, &remaining, &movement](auto& transform) {
+        [&movement](auto& transform) {
             transform.position += movement;
         }
     );
 
-    // If we're at the end of the path or we have no budget left, exit
-    if (path.current == path.path.size() || budget == 0)
+    if (!segment_done)
         return;
 
-    // Otherwise, point in the next direction
+    // Generate the next segment from the route, unless this was the last
+    if (!Pathfinding::next_segment(registry, *path.route, path.cursor, path.segment)) {
+        path.finished = true;
+        return;
+    }
+
+    // Point in the next direction
+    const Direction::TDirection direction { path.segment.direction };
+
     registry.patch<VelocityComponent>(
         entity,
-        [path](auto& vel) {
-            vel.direction_vector = Direction::isometric_direction_vectors.at(
-                path.path.at(path.current).direction
-            );
+        [direction](auto& vel) {
+            vel.direction_vector = Direction::isometric_direction_vectors.at(direction);
         }
     );
 
     registry.patch<SpriteComponent>(
         entity,
-        [&spritesheet, &path](auto& sprite) {
+        [&spritesheet, direction](auto& sprite) {
             const std::string& walker {
-                Constants::WALKER_DIRECTIONS.at(
-                    path.path.at(path.current).direction
-                )
+                Constants::WALKER_DIRECTIONS.at(direction)
             };
             sprite.sprite_definition = &spritesheet.sprites.at(walker);
         }
@@ -82,15 +84,15 @@ void update(entt::registry& registry, const float delta_time)
 
     for (auto [entity, transform, velocity, path] : view.each()) {
 
-        if (path.current >= path.path.size()) {
+        if (path.finished) {
             registry.emplace_or_replace<EntityReleaseFlag>(entity);
             continue;
         }
 
         float budget { velocity.speed * delta_time };
-        while (budget > 0 && path.current != path.path.size()) {
+        while (budget > 0 && !path.finished) {
             advance(registry, entity, spritesheet, budget, transform, path);
         }
     }
 }
-}
\ No newline at end of file
+}
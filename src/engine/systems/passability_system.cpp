@@ -0,0 +1,62 @@
+#include <components/flags.h>
+#include <components/grid_position_component.h>
+#include <components/sprite_component.h>
+#include <entt/entt.hpp>
+#include <grid.h>
+#include <grid_pathfinding.h>
+#include <passability_system.h>
+#include <projection.h>
+
+namespace {
+
+bool tile_is_passable(const entt::registry& registry, entt::entity tile)
+{
+    if (tile == entt::null)
+        return false;
+
+    const SpriteComponent* sprite { registry.try_get<const SpriteComponent>(tile) };
+    return sprite && sprite->sprite_definition->passable;
+}
+
+} // namespace
+
+namespace PassabilitySystem {
+
+void update(entt::registry& registry)
+{
+    auto update_queue { registry.view<PassabilityUpdateFlag>() };
+    if (update_queue.begin() == update_queue.end())
+        return;
+
+    const Grid<entt::entity, TileMapProjection>& tilemap {
+        registry.ctx().get<const Grid<entt::entity, TileMapProjection>>()
+    };
+
+    PassabilityMap& passability { registry.ctx().get<PassabilityMap>() };
+
+    if (passability.dimensions != tilemap.grid_dimensions) {
+        passability.resize(tilemap.grid_dimensions);
+        for (int index = 0; index < int(tilemap.cells.size()); index++) {
+            passability.set(
+                index_to_grid_position(index, tilemap),
+                tile_is_passable(registry, tilemap.cells[index])
+            );
+        }
+    } else {
+        for (auto entity : update_queue) {
+            const GridPositionComponent* grid_position { registry.try_get<const GridPositionComponent>(entity) };
+
+            // Only the tiles themselves decide passability
+            if (!grid_position || !tilemap.position_is_valid(grid_position->position))
+                continue;
+            if (tilemap[grid_position->position] != entity)
+                continue;
+
+            passability.set(grid_position->position, tile_is_passable(registry, entity));
+        }
+    }
+
+    registry.clear<PassabilityUpdateFlag>();
+}
+
+} // namespace
@@ -0,0 +1,10 @@
+#ifndef PASSABILITYSYSTEM_H
+#define PASSABILITYSYSTEM_H
+
+#include <entt/entt.hpp>
+
+namespace PassabilitySystem {
+void update(entt::registry& registry);
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include <components/building_pair_component.h>
 #include <components/connectivity_component.h>
 #include <components/flags.h>
+#include <components/graph_state_component.h>
 #include <components/grid_position_component.h>
 #include <components/junction_component.h>
 #include <components/mouse_component.h>
@@ -14,15 +15,21 @@
 #include <components/spatialmapcell_component.h>
 #include <components/sprite_component.h>
 #include <components/transform_component.h>
+#include <components/unroutable_component.h>
 #include <constants.h>
 #include <directions.h>
 #include <entt/entt.hpp>
+#include <flow_fields.h>
 #include <grid.h>
 #include <imgui.h>
 #include <iso_utility.h>
+#include <path_cache.h>
 #include <pathfinding.h>
+#include <pathfinding_context.h>
 #include <position.h>
 #include <projection.h>
+#include <road_graph.h>
+#include <route_store.h>
 #include <sprite.h>
 #include <spritesheet.h>
 #include <string>
@@ -239,6 +246,71 @@ void render_imgui_ui(
     ImGui::Text("Junctions: %d", static_cast<int>(junctions_view.size()));
     ImGui::Text("Segments: %d", static_cast<int>(segments_view.size()));
 
+    if (const RoadGraph* graph { registry.ctx().find<const RoadGraph>() }) {
+        ImGui::Text(
+            "Junction links: %d (%.2f per junction)",
+            static_cast<int>(graph->edge_count()),
+            graph->junction_count() ? float(graph->edge_count()) / graph->junction_count() : 0.f
+        );
+    }
+
+    if (GraphStateComponent* graph_state { registry.ctx().find<GraphStateComponent>() }) {
+        ImGui::SliderFloat("Rebuild budget (ms)", &graph_state->rebuild_budget_millis, 0.f, Constants::MILLIS_PER_FRAME);
+        if (graph_state->rebuild_progress < 1.f)
+            ImGui::ProgressBar(graph_state->rebuild_progress, { -1.f, 0.f }, "Rebuilding graph");
+        if (graph_state->hierarchy_stale)
+            ImGui::Text("Landmarks and hierarchy wait for edits to settle");
+        const GraphChanges& changes { graph_state->changes };
+        ImGui::Text(
+            "Last change: junctions +%d -%d ~%d, segments +%d -%d ~%d",
+            static_cast<int>(changes.added_junctions.size()),
+            static_cast<int>(changes.removed_junctions.size()),
+            static_cast<int>(changes.modified_junctions.size()),
+            static_cast<int>(changes.added_segments.size()),
+            static_cast<int>(changes.removed_segments.size()),
+            static_cast<int>(changes.modified_segments.size())
+        );
+        ImGui::Checkbox("Check local rebuilds", &graph_state->check_rebuilds);
+        ImGui::Text("Failed checks: %llu", static_cast<unsigned long long>(graph_state->check_failures));
+    }
+
+    if (PathfindingContext* context { registry.ctx().find<PathfindingContext>() }) {
+        ImGui::Checkbox("Landmark heuristic", &context->use_landmarks);
+        ImGui::Text(
+            "Junctions expanded: %llu over %llu searches",
+            static_cast<unsigned long long>(context->expanded),
+            static_cast<unsigned long long>(context->searches)
+        );
+
+        if (ImGui::Button("Reset search counters")) {
+            context->expanded = 0;
+            context->searches = 0;
+        }
+    }
+
+    if (FlowFields* flow_fields { registry.ctx().find<FlowFields>() }) {
+        ImGui::Checkbox("Flow fields", &flow_fields->enabled);
+        ImGui::Text("Flow fields built: %d", static_cast<int>(flow_fields->fields.size()));
+    }
+
+    if (const PathCache* path_cache { registry.ctx().find<const PathCache>() }) {
+        ImGui::Text(
+            "Path cache hit rate: %.1f%% (%llu/%llu)",
+            path_cache->hit_rate() * 100.f,
+            static_cast<unsigned long long>(path_cache->hits),
+            static_cast<unsigned long long>(path_cache->hits + path_cache->misses)
+        );
+    }
+
+    if (const RouteStore* route_store { registry.ctx().find<const RouteStore>() }) {
+        ImGui::Text("Shared routes: %d", static_cast<int>(route_store->size()));
+    }
+
+    ImGui::Text(
+        "Unroutable senders: %d",
+        static_cast<int>(registry.view<UnroutableComponent>().size())
+    );
+
     auto pairs_view { registry.view<BuildingPairComponent>() };
     if (pairs_view.begin() != pairs_view.end()) {
         ImGui::SeparatorText("Building Pairs");
@@ -1,33 +1,232 @@
+#include <algorithm>
+#include <chrono>
 #include <components/building_pair_component.h>
 #include <components/connectivity_component.h>
 #include <components/flags.h>
+#include <components/graph_state_component.h>
+#include <components/grid_position_component.h>
 #include <components/origin_component.h>
 #include <components/path_component.h>
 #include <components/render_offset_component.h>
 #include <components/road_access_component.h>
 #include <components/sprite_component.h>
 #include <components/transform_component.h>
+#include <components/unroutable_component.h>
 #include <components/velocity_component.h>
 #include <components/walker_component.h>
 #include <constants.h>
+#include <cstdint>
 #include <directions.h>
 #include <entt/entt.hpp>
+#include <flow_fields.h>
 #include <grid.h>
+#include <path_cache.h>
 #include <pathfinding.h>
+#include <pathfinding_context.h>
 #include <projection.h>
+#include <route_store.h>
 #include <spritesheet.h>
 #include <systems/walker_system.h>
+#include <utility>
+#include <vector>
+#include <worker_pool.h>
+
+namespace {
+
+using TileMapType = Grid<entt::entity, TileMapProjection>;
+
+// A pending sender, and the route found for it
+struct PathJob {
+    entt::entity building;
+    const std::vector<entt::entity>* origins;
+    entt::entity receiver;
+    entt::entity target_tile;
+    const ReverseSearch* field;
+    // Set when served from the cache
+    Route route;
+    int cost;
+    std::vector<entt::entity> path;
+};
+
+// Search contexts for the pool's own threads - the calling thread uses the
+// one Pathfinding keeps - refreshed whenever the graph is rebuilt
+struct PathResolution {
+    uint64_t generation { UINT64_MAX };
+    // Landmarks may be placed after the generation was copied
+    size_t landmark_count { 0 };
+    std::vector<PathfindingContext> contexts;
+    std::vector<PathJob> jobs;
+
+    // Running estimate of the time a search takes, for fitting retries of
+    // unroutable senders into their budget
+    float micros_per_search { 50.f };
+};
+
+void copy_context(const PathfindingContext& source, PathfindingContext& destination)
+{
+    destination = source;
+
+    // Copies don't keep spare capacity; searches rely on it not to allocate
+    destination.forward.frontier.reserve(source.forward.frontier.capacity());
+    destination.backward.frontier.reserve(source.backward.frontier.capacity());
+}
+
+void resolve(const entt::registry& registry, PathfindingContext& context, PathJob& job)
+{
+    // One search seeded from every access point picks the best of them
+    if (job.field)
+        job.cost = Pathfinding::path_from_field(registry, context, *job.field, *job.origins, job.path);
+    else
+        job.cost = Pathfinding::path_between(registry, context, *job.origins, job.target_tile, job.path);
+}
+
+/*
+    Point the jobs for busy receivers at a flow field, building the fields
+    that are missing in parallel. A receiver gets a field once enough of its
+    senders are waiting at the same time, and keeps it until the next rebuild.
+*/
+void assign_flow_fields(
+    entt::registry& registry,
+    const PathfindingContext& context,
+    WorkerPool& pool,
+    uint64_t generation,
+    std::vector<PathJob>& jobs,
+    size_t job_count
+)
+{
+    FlowFields& flow_fields { registry.ctx().emplace<FlowFields>() };
+    if (!flow_fields.enabled)
+        return;
+
+    if (flow_fields.generation != generation) {
+        flow_fields.fields.clear();
+        flow_fields.generation = generation;
+    }
+
+    flow_fields.waiting.clear();
+    for (size_t index = 0; index < job_count; index++) {
+        if (!jobs[index].route)
+            flow_fields.waiting[jobs[index].receiver]++;
+    }
+
+    std::vector<std::pair<ReverseSearch*, entt::entity>> unbuilt {};
+    for (size_t index = 0; index < job_count; index++) {
+        PathJob& job { jobs[index] };
+        if (job.route)
+            continue;
+
+        auto field { flow_fields.fields.find(job.receiver) };
+        if (field == flow_fields.fields.end() || field->second.target_tile != job.target_tile) {
+            if (flow_fields.waiting[job.receiver] < Constants::FLOW_FIELD_MIN_SENDERS)
+                continue;
+
+            ReverseSearch& search { flow_fields.fields[job.receiver] };
+            search.target_tile = job.target_tile;
+            unbuilt.emplace_back(&search, job.target_tile);
+            field = flow_fields.fields.find(job.receiver);
+        }
+
+        job.field = &field->second;
+    }
+
+    const entt::registry& frozen_registry { registry };
+    pool.run(unbuilt.size(), [&](size_t, size_t index) {
+        auto [field, target] { unbuilt[index] };
+        Pathfinding::build_flow_field(frozen_registry, context, *field, target);
+    });
+}
+
+// Searches back from each target repaired towards since the latest rebuild
+struct PathRepair {
+    uint64_t generation { 0 };
+    std::vector<ReverseSearch> searches;
+    size_t search_count { 0 };
+    std::vector<glm::ivec2> changed_positions;
+    std::vector<entt::entity> path;
+};
+
+// TODO: idiomatic/repeatable way to get sprite position from entity
+entt::entity target_tile(
+    const entt::registry& registry,
+    const TileMapType& tilemap,
+    const BuildingPairComponent& building_pair
+)
+{
+    return tilemap.at_world(
+        glm::ivec2 { registry.get<const TransformComponent>(building_pair.paired_with).position }
+        + registry.get<const SpriteComponent>(building_pair.paired_with).sprite_definition->anchor
+    );
+}
+
+// Whether the walker has yet to pass any of the positions. Runs between route
+// tiles are straight, so a bounds check per run covers every tile on it
+bool path_crosses(
+    const entt::registry& registry,
+    const TileMapType& tilemap,
+    const TransformComponent& transform,
+    const PathComponent& path,
+    const std::vector<glm::ivec2>& positions
+)
+{
+    glm::ivec2 from { TileMapProjection::world_to_grid(glm::ivec2 { transform.position }, tilemap) };
+
+    const std::vector<entt::entity>& route { *path.route };
+    for (size_t index = path.cursor.leg + 1; index < route.size(); index++) {
+        glm::ivec2 to { registry.get<const GridPositionComponent>(route[index]).position };
+        glm::ivec2 lower { glm::min(from, to) };
+        glm::ivec2 upper { glm::max(from, to) };
+
+        for (const glm::ivec2& position : positions) {
+            if (
+                position.x >= lower.x && position.x <= upper.x
+                && position.y >= lower.y && position.y <= upper.y
+            )
+                return true;
+        }
+
+        from = to;
+    }
+
+    return false;
+}
+
+ReverseSearch& search_towards(
+    const entt::registry& registry,
+    const PathfindingContext& context,
+    PathRepair& repair,
+    entt::entity target
+)
+{
+    for (size_t index = 0; index < repair.search_count; index++) {
+        if (repair.searches[index].target_tile == target)
+            return repair.searches[index];
+    }
+
+    if (repair.search_count == repair.searches.size())
+        repair.searches.emplace_back();
+
+    ReverseSearch& search { repair.searches[repair.search_count++] };
+    Pathfinding::prepare_reverse_search(registry, context, search, target);
+    return search;
+}
+
+} // namespace
 
 namespace WalkerSystem {
 void create(
     entt::registry& registry,
     entt::entity origin_building_entity,
-    const std::vector<PathSegment>& expanded_path,
+    const Route& route,
     const SpriteSheet& spritesheet
 )
 {
+    RouteCursor cursor {};
+    PathSegment first_segment { {}, {}, Direction::TDirection::NO_DIRECTION };
+    if (!Pathfinding::next_segment(registry, *route, cursor, first_segment))
+        return;
+
     entt::entity walker_entity { registry.create() };
-    registry.emplace<PathComponent>(walker_entity, expanded_path);
+    registry.emplace<PathComponent>(walker_entity, route, first_segment, cursor);
     registry.emplace<WalkerComponent>(origin_building_entity, walker_entity);
     registry.emplace<OriginComponent>(walker_entity, origin_building_entity);
 
@@ -35,14 +234,14 @@ void create(
         registry.emplace<SpriteComponent>(
             walker_entity,
             &spritesheet.sprites.at(
-                Constants::WALKER_DIRECTIONS.at(expanded_path.front().direction)
+                Constants::WALKER_DIRECTIONS.at(first_segment.direction)
             )
         )
     };
 
     registry.emplace<TransformComponent>(
         walker_entity,
-        expanded_path.front().start,
+        first_segment.start,
         1,
         0.0
     );
@@ -54,7 +253,7 @@ void create(
 
     registry.emplace<VelocityComponent>(
         walker_entity,
-        Direction::isometric_direction_vectors.at(expanded_path.front().direction),
+        Direction::isometric_direction_vectors.at(first_segment.direction),
         60 // TODO - should be encoded in the sprite definition JSON
     );
 }
@@ -86,40 +285,206 @@ void update(entt::registry& registry)
     if (pending.begin() == pending.end())
         return;
 
-    using TileMapType = Grid<entt::entity, TileMapProjection>;
-    const TileMapType tilemap { registry.ctx().get<const TileMapType>() };
-    std::vector<entt::entity> path {};
+    const TileMapType& tilemap { registry.ctx().get<const TileMapType>() };
+
+    PathCache& path_cache { registry.ctx().get<PathCache>() };
+    RouteStore& route_store { registry.ctx().get<RouteStore>() };
+    const uint64_t generation { registry.ctx().get<const GraphStateComponent>().generation };
+    const SpriteSheet& spritesheet { registry.ctx().get<const SpriteSheet>() };
+    WorkerPool& pool { registry.ctx().get<WorkerPool>() };
+
+    PathfindingContext& main_context { registry.ctx().emplace<PathfindingContext>() };
+    PathResolution& resolution { registry.ctx().emplace<PathResolution>() };
+
+    if (resolution.generation != generation || resolution.landmark_count != main_context.landmark_count) {
+        resolution.contexts.resize(pool.size() - 1);
+        for (PathfindingContext& context : resolution.contexts) {
+            copy_context(main_context, context);
+        }
+        resolution.generation = generation;
+        resolution.landmark_count = main_context.landmark_count;
+    }
+
+    for (PathfindingContext& context : resolution.contexts) {
+        context.use_landmarks = main_context.use_landmarks;
+    }
+
+    // Senders that failed on an older graph are retried a few each frame
+    const size_t retry_allowance {
+        std::max<size_t>(1, static_cast<size_t>(Constants::RETRY_BUDGET_MICROS / resolution.micros_per_search))
+    };
+    size_t retries { 0 };
+
+    // Gather the pending senders, serving what we can from the cache
+    std::vector<PathJob>& jobs { resolution.jobs };
+    size_t job_count { 0 };
 
     for (auto [building_entity, building_pair, road_access] : pending.each()) {
-        path.clear();
+        const UnroutableComponent* unroutable { registry.try_get<const UnroutableComponent>(building_entity) };
+        if (unroutable && unroutable->receiver == building_pair.paired_with) {
+            // Nothing has changed since the search failed
+            if (unroutable->generation == generation || retries == retry_allowance)
+                continue;
+            retries++;
+        }
 
-        // TODO: idiomatic/repeatable way to get sprite position from entity
-        entt::entity target_tile {
-            tilemap.at_world(
-                glm::ivec2 { registry.get<const TransformComponent>(building_pair.paired_with).position }
-                + registry.get<const SpriteComponent>(building_pair.paired_with).sprite_definition->anchor
-            )
-        };
-
-        // Get the first viable path, even if not the best
-        for (entt::entity access_point : road_access.road_access_points) {
-            Pathfinding::path_between(
-                registry,
-                access_point,
-                target_tile,
-                path
+        if (job_count == jobs.size())
+            jobs.emplace_back();
+
+        PathJob& job { jobs[job_count++] };
+        job.building = building_entity;
+        job.origins = &road_access.road_access_points;
+        job.receiver = building_pair.paired_with;
+        job.field = nullptr;
+        job.path.clear();
+        job.target_tile = target_tile(registry, tilemap, building_pair);
+
+        job.route = path_cache.lookup(road_access.road_access_points, job.target_tile, generation);
+    }
+
+    assign_flow_fields(registry, main_context, pool, generation, jobs, job_count);
+
+    // Search in parallel; nothing touches the registry until every job is done
+    const entt::registry& frozen_registry { registry };
+    const auto search_start { std::chrono::steady_clock::now() };
+    pool.run(job_count, [&](size_t worker, size_t index) {
+        PathJob& job { jobs[index] };
+        if (!job.route)
+            resolve(frozen_registry, worker == 0 ? main_context : resolution.contexts[worker - 1], job);
+    });
+
+    const size_t searched {
+        static_cast<size_t>(std::count_if(jobs.begin(), jobs.begin() + job_count, [](const PathJob& job) {
+            return !job.route;
+        }))
+    };
+
+    if (searched > 0) {
+        const std::chrono::duration<float, std::micro> elapsed { std::chrono::steady_clock::now() - search_start };
+        resolution.micros_per_search = 0.8f * resolution.micros_per_search + 0.2f * elapsed.count() / searched;
+    }
+
+    // Gather the workers' debug counters where the debug panel reads them
+    for (PathfindingContext& context : resolution.contexts) {
+        main_context.searches += std::exchange(context.searches, 0);
+        main_context.expanded += std::exchange(context.expanded, 0);
+    }
+
+    for (size_t index = 0; index < job_count; index++) {
+        PathJob& job { jobs[index] };
+
+        if (!job.route) {
+            // Unreachable, or the access point is already beside the target;
+            // either way nothing changes until the graph does
+            if (job.path.size() < 2) {
+                registry.emplace_or_replace<UnroutableComponent>(job.building, job.receiver, generation);
+                continue;
+            }
+
+            job.route = route_store.intern(job.path);
+            path_cache.store(
+                *job.origins,
+                job.path.front(),
+                job.target_tile,
+                generation,
+                job.cost,
+                job.route
             );
-            if (!path.empty())
-                break;
         }
 
-        if (path.empty())
+        registry.remove<UnroutableComponent>(job.building);
+        create(registry, job.building, job.route, spritesheet);
+
+        // Jobs are reused; don't keep the route alive until then
+        job.route = nullptr;
+    }
+}
+
+/*
+    Walkers whose remaining path crosses a tile changed by the latest rebuild
+    are rerouted from where they stand; everyone else keeps their path. The
+    repairs towards a target share one search back from it, so each walker
+    after the first only extends that search as far as its own position.
+*/
+void repair(entt::registry& registry)
+{
+    const GraphStateComponent& graph_state { registry.ctx().get<const GraphStateComponent>() };
+    PathRepair& repair { registry.ctx().emplace<PathRepair>() };
+
+    if (repair.generation == graph_state.generation)
+        return;
+
+    repair.generation = graph_state.generation;
+    repair.search_count = 0;
+    repair.changed_positions.clear();
+
+    for (entt::entity tile : graph_state.changed_tiles) {
+        if (const GridPositionComponent* grid_position { registry.try_get<const GridPositionComponent>(tile) })
+            repair.changed_positions.push_back(grid_position->position);
+    }
+
+    if (repair.changed_positions.empty())
+        return;
+
+    const TileMapType& tilemap { registry.ctx().get<const TileMapType>() };
+    const SpriteSheet& spritesheet { registry.ctx().get<const SpriteSheet>() };
+    RouteStore& route_store { registry.ctx().get<RouteStore>() };
+    PathfindingContext& context { registry.ctx().emplace<PathfindingContext>() };
+
+    auto walkers { registry.view<PathComponent, TransformComponent, OriginComponent>() };
+    for (auto [walker_entity, path, transform, origin] : walkers.each()) {
+        if (path.finished || !path_crosses(registry, tilemap, transform, path, repair.changed_positions))
+            continue;
+
+        repair.path.clear();
+
+        const BuildingPairComponent* building_pair { registry.try_get<const BuildingPairComponent>(origin.origin) };
+        entt::entity current_tile { tilemap.at_world(glm::ivec2 { transform.position }) };
+        int cost { Pathfinding::NO_ROUTE };
+
+        if (building_pair && current_tile != entt::null) {
+            ReverseSearch& search {
+                search_towards(registry, context, repair, target_tile(registry, tilemap, *building_pair))
+            };
+            cost = Pathfinding::path_between(registry, context, search, current_tile, repair.path);
+        }
+
+        // Stranded; let the sender try again once there's a way through
+        if (cost == Pathfinding::NO_ROUTE) {
+            registry.emplace_or_replace<EntityReleaseFlag>(walker_entity);
+            continue;
+        }
+
+        path.route = route_store.intern(repair.path);
+        path.cursor = {};
+
+        // Already beside the target; the walker finishes next frame
+        RouteCursor peek {};
+        if (!Pathfinding::next_segment(registry, *path.route, peek, path.segment)) {
+            path.finished = true;
             continue;
+        }
 
-        std::vector<PathSegment> expanded_path {};
-        Pathfinding::expand_path(registry, path, expanded_path);
-        const SpriteSheet& spritesheet { registry.ctx().get<const SpriteSheet>() };
-        create(registry, building_entity, expanded_path, spritesheet);
+        // Join the new route from wherever the walker is within its tile; its
+        // first segment is generated again once the walker gets there
+        path.segment = { transform.position, path.segment.start, path.segment.direction };
+        const PathSegment& first_segment { path.segment };
+
+        registry.patch<VelocityComponent>(
+            walker_entity,
+            [&first_segment](auto& velocity) {
+                velocity.direction_vector = Direction::isometric_direction_vectors.at(first_segment.direction);
+            }
+        );
+
+        registry.patch<SpriteComponent>(
+            walker_entity,
+            [&spritesheet, &first_segment](auto& sprite) {
+                sprite.sprite_definition = &spritesheet.sprites.at(
+                    Constants::WALKER_DIRECTIONS.at(first_segment.direction)
+                );
+            }
+        );
     }
 }
-}
\ No newline at end of file
+}
@@ -1,19 +1,20 @@
 #ifndef WALKERSYSTEM_H
 #define WALKERSYSTEM_H
 
-#include <components/path_component.h>
 #include <entt/entt.hpp>
+#include <route_store.h>
 #include <spritesheet.h>
 
 namespace WalkerSystem {
 void create(
     entt::registry& registry,
     entt::entity origin_building_entity,
-    const std::vector<PathSegment>& expanded_path,
+    const Route& route,
     const SpriteSheet& spritesheet
 );
 void remove(entt::registry& registry, entt::entity walker);
 void update(entt::registry& registry);
+void repair(entt::registry& registry);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include <mutex>
+#include <thread>
+#include <worker_pool.h>
+
+WorkerPool::WorkerPool(size_t thread_count)
+{
+    threads.reserve(thread_count);
+    for (size_t worker = 1; worker <= thread_count; worker++) {
+        threads.emplace_back(&WorkerPool::work, this, worker);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        stopping = true;
+    }
+    batch_ready.notify_all();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::drain(size_t worker)
+{
+    for (size_t index = next_job++; index < job_count; index = next_job++) {
+        (*job)(worker, index);
+    }
+}
+
+void WorkerPool::work(size_t worker)
+{
+    uint64_t seen_batch { 0 };
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock { mutex };
+            batch_ready.wait(lock, [&] { return stopping || batch != seen_batch; });
+            if (stopping)
+                return;
+            seen_batch = batch;
+        }
+
+        drain(worker);
+
+        std::lock_guard<std::mutex> lock { mutex };
+        if (--busy == 0)
+            batch_done.notify_one();
+    }
+}
+
+void WorkerPool::run(size_t count, const Job& batch_job)
+{
+    if (count == 0)
+        return;
+
+    // Not worth waking anyone for
+    if (threads.empty() || count == 1) {
+        for (size_t index = 0; index < count; index++) {
+            batch_job(0, index);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock { mutex };
+        job = &batch_job;
+        job_count = count;
+        next_job = 0;
+        busy = threads.size();
+        batch++;
+    }
+    batch_ready.notify_all();
+
+    drain(0);
+
+    std::unique_lock<std::mutex> lock { mutex };
+    batch_done.wait(lock, [this] { return busy == 0; });
+    job = nullptr;
+}
@@ -0,0 +1,51 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    Fixed set of threads that work through a batch of independent jobs.
+
+    run() blocks until the whole batch is done and the calling thread takes
+    jobs alongside the workers, so a pool with no threads still works. Jobs
+    are told which worker is running them (0 being the caller) so that they
+    can keep per-worker scratch without locking.
+*/
+class WorkerPool {
+    using Job = std::function<void(size_t worker, size_t job)>;
+
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable batch_ready;
+    std::condition_variable batch_done;
+
+    const Job* job { nullptr };
+    size_t job_count { 0 };
+    std::atomic<size_t> next_job { 0 };
+    size_t busy { 0 };
+    uint64_t batch { 0 };
+    bool stopping { false };
+
+    void drain(size_t worker);
+    void work(size_t worker);
+
+public:
+    WorkerPool(size_t thread_count);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Workers available to a batch, including the calling thread
+    size_t size() const { return threads.size() + 1; }
+
+    void run(size_t count, const Job& batch_job);
+};
+
+#endif